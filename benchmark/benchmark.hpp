@@ -0,0 +1,7 @@
+#ifndef HTTPREQUEST_BENCHMARK_HPP
+#define HTTPREQUEST_BENCHMARK_HPP
+
+void benchmarkChunked();
+void benchmarkHeader();
+
+#endif // HTTPREQUEST_BENCHMARK_HPP
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "HTTPRequest.hpp"
+#include "benchmark.hpp"
+
+namespace
+{
+    // a response with the body split into chunks of the given size
+    std::string makeChunkedResponse(const std::size_t bodySize, const std::size_t chunkSize)
+    {
+        std::string result = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+        std::ostringstream sizeLine;
+        sizeLine << std::hex << chunkSize << "\r\n";
+        const std::string chunk = sizeLine.str() + std::string(chunkSize, 'a') + "\r\n";
+
+        for (std::size_t size = 0; size < bodySize; size += chunkSize)
+            result += chunk;
+
+        result += "0\r\n\r\n";
+        return result;
+    }
+
+    // feeds the response to the parser in pieces the size of a socket read and returns the best time
+    std::chrono::nanoseconds parse(const std::string& response, const std::size_t bodySize, const int iterations)
+    {
+        constexpr std::size_t readSize = 4096;
+        auto best = std::chrono::nanoseconds::max();
+
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            http::ResponseParser parser{"GET"};
+            const auto data = reinterpret_cast<const std::uint8_t*>(response.data());
+            for (std::size_t offset = 0; offset < response.size(); offset += readSize)
+                parser.parse(data + offset, (std::min)(readSize, response.size() - offset));
+
+            const auto duration = std::chrono::steady_clock::now() - start;
+
+            if (!parser.isComplete() || parser.getResponse().body.size() < bodySize)
+                throw std::runtime_error{"Failed to parse the response"};
+
+            best = (std::min)(best, std::chrono::duration_cast<std::chrono::nanoseconds>(duration));
+        }
+
+        return best;
+    }
+}
+
+void benchmarkChunked()
+{
+    constexpr std::size_t bodySize = 4 * 1024 * 1024;
+    constexpr int iterations = 10;
+
+    std::cout << std::setw(12) << "chunk size"
+        << std::setw(12) << "chunks"
+        << std::setw(16) << "input MB/s"
+        << std::setw(16) << "Mchunks/s" << '\n';
+
+    for (const std::size_t chunkSize : {1, 4, 16, 64, 256, 4096})
+    {
+        const auto response = makeChunkedResponse(bodySize, chunkSize);
+        const auto chunks = (bodySize + chunkSize - 1) / chunkSize;
+        const auto seconds = std::chrono::duration<double>{parse(response, bodySize, iterations)}.count();
+
+        std::cout << std::setw(12) << chunkSize
+            << std::setw(12) << chunks
+            << std::setw(16) << std::fixed << std::setprecision(1) << static_cast<double>(response.size()) / seconds / 1e6
+            << std::setw(16) << std::fixed << std::setprecision(2) << static_cast<double>(chunks) / seconds / 1e6 << '\n';
+    }
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "HTTPRequest.hpp"
+#include "benchmark.hpp"
+
+namespace
+{
+    // a response with a header of the given number of fields with values of the given length
+    std::string makeResponse(const std::size_t fieldCount, const std::size_t valueLength)
+    {
+        std::string result = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n";
+
+        for (std::size_t i = 0; i < fieldCount; ++i)
+            result += "X-Field-" + std::to_string(i) + ": " + std::string(valueLength, 'v') + "\r\n";
+
+        result += "\r\n";
+        return result;
+    }
+
+    // parses the whole response at once and returns the best time
+    std::chrono::nanoseconds parse(const std::string& response, const std::size_t fieldCount, const int iterations)
+    {
+        auto best = std::chrono::nanoseconds::max();
+
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            http::ResponseParser parser{"GET"};
+            parser.parse(reinterpret_cast<const std::uint8_t*>(response.data()), response.size());
+
+            const auto duration = std::chrono::steady_clock::now() - start;
+
+            if (!parser.isComplete() || parser.getResponse().headerFields.size() != fieldCount + 1)
+                throw std::runtime_error{"Failed to parse the response"};
+
+            best = (std::min)(best, std::chrono::duration_cast<std::chrono::nanoseconds>(duration));
+        }
+
+        return best;
+    }
+}
+
+void benchmarkHeader()
+{
+    constexpr std::size_t headerSize = 1024 * 1024;
+    constexpr int iterations = 10;
+
+    std::cout << std::setw(12) << "value size"
+        << std::setw(12) << "fields"
+        << std::setw(16) << "input MB/s"
+        << std::setw(16) << "Mfields/s" << '\n';
+
+    for (const std::size_t valueLength : {8, 64, 512, 4096})
+    {
+        const auto fieldCount = headerSize / valueLength;
+        const auto response = makeResponse(fieldCount, valueLength);
+        const auto seconds = std::chrono::duration<double>{parse(response, fieldCount, iterations)}.count();
+
+        std::cout << std::setw(12) << valueLength
+            << std::setw(12) << fieldCount
+            << std::setw(16) << std::fixed << std::setprecision(1) << static_cast<double>(response.size()) / seconds / 1e6
+            << std::setw(16) << std::fixed << std::setprecision(2) << static_cast<double>(fieldCount) / seconds / 1e6 << '\n';
+    }
+}
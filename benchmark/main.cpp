@@ -0,0 +1,11 @@
+#include <iostream>
+#include "benchmark.hpp"
+
+int main()
+{
+    benchmarkChunked();
+    std::cout << '\n';
+    benchmarkHeader();
+
+    return 0;
+}
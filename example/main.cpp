@@ -38,6 +38,8 @@ int main(int argc, const char* argv[])
                         protocol = http::InternetProtocol::v4;
                     else if (std::string{argv[i]} == "ipv6")
                         protocol = http::InternetProtocol::v6;
+                    else if (std::string{argv[i]} == "any")
+                        protocol = http::InternetProtocol::any;
                     else
                         throw std::runtime_error{"Invalid protocol"};
                 }
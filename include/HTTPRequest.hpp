@@ -11,16 +11,42 @@
 #include <cstring>
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <future>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <system_error>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#  include <coroutine>
+#endif // defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#if __has_include(<memory_resource>)
+#  include <memory_resource>
+#endif // __has_include(<memory_resource>)
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#endif // defined(__AVX2__)
 
 #if defined(_WIN32) || defined(__CYGWIN__)
 #  pragma push_macro("WIN32_LEAN_AND_MEAN")
@@ -32,6 +58,9 @@
 #    define NOMINMAX
 #  endif // NOMINMAX
 #  include <winsock2.h>
+#  include <fcntl.h>
+#  include <io.h>
+#  include <sys/stat.h>
 #  if _WIN32_WINNT < _WIN32_WINNT_WINXP
 extern "C" char *_strdup(const char *strSource);
 #    define strdup _strdup
@@ -44,11 +73,25 @@ extern "C" char *_strdup(const char *strSource);
 #  include <errno.h>
 #  include <fcntl.h>
 #  include <netinet/in.h>
+#  include <netinet/tcp.h>
 #  include <netdb.h>
-#  include <sys/select.h>
+#  include <poll.h>
 #  include <sys/socket.h>
+#  include <sys/stat.h>
 #  include <sys/types.h>
 #  include <unistd.h>
+#  if defined(__linux__)
+#    include <signal.h>
+#    include <time.h>
+#    include <sys/epoll.h>
+#    include <sys/eventfd.h>
+#    include <sys/sendfile.h>
+#    if __has_include(<linux/io_uring.h>)
+#      include <linux/io_uring.h>
+#      include <sys/mman.h>
+#      include <sys/syscall.h>
+#    endif // __has_include(<linux/io_uring.h>)
+#  endif // defined(__linux__)
 #endif // defined(_WIN32) || defined(__CYGWIN__)
 
 namespace http
@@ -70,7 +113,8 @@ namespace http
     enum class InternetProtocol: std::uint8_t
     {
         v4,
-        v6
+        v6,
+        any // race IPv6 and IPv4 connections (RFC 8305, Happy Eyeballs)
     };
 
     struct Uri final
@@ -171,6 +215,69 @@ namespace http
     using HeaderField = std::pair<std::string, std::string>;
     using HeaderFields = std::vector<HeaderField>;
 
+    // IDs of the common header field names, which are recognized with a perfect hash while parsing
+    enum class HeaderId: std::uint8_t
+    {
+        unknown,
+        acceptRanges,
+        accessControlAllowOrigin,
+        age,
+        altSvc,
+        cacheControl,
+        connection,
+        contentDisposition,
+        contentEncoding,
+        contentLanguage,
+        contentLength,
+        contentLocation,
+        contentRange,
+        contentSecurityPolicy,
+        contentType,
+        date,
+        etag,
+        expires,
+        keepAlive,
+        lastModified,
+        link,
+        location,
+        pragma,
+        proxyAuthenticate,
+        retryAfter,
+        server,
+        setCookie,
+        strictTransportSecurity,
+        trailer,
+        transferEncoding,
+        upgrade,
+        vary,
+        via,
+        wwwAuthenticate,
+        xContentTypeOptions,
+        xFrameOptions
+    };
+
+    // Options applied to the sockets when they are created, the zero and negative values keep the system defaults
+    struct SocketOptions final
+    {
+        // TCP_NODELAY, disables Nagle's algorithm, so that small requests are sent without waiting for acknowledgements
+        bool noDelay = false;
+        // SO_RCVBUF and SO_SNDBUF in bytes
+        int receiveBufferSize = 0;
+        int sendBufferSize = 0;
+        // SO_KEEPALIVE, the probe settings are only used if keep-alive is enabled and the platform supports them
+        bool keepAlive = false;
+        std::chrono::seconds keepAliveIdle{0}; // idle time before the first probe
+        std::chrono::seconds keepAliveInterval{0}; // time between the probes
+        int keepAliveCount = 0; // number of unanswered probes before the connection is dropped
+        // SO_PRIORITY (Linux only)
+        int priority = -1;
+        // IP_TOS for IPv4 and IPV6_TCLASS for IPv6 sockets
+        int typeOfService = -1;
+        // TCP Fast Open (RFC 7413, Linux only), sends the beginning of idempotent requests in the SYN of new connections,
+        // connections are opened normally if the kernel or the server doesn't support it
+        bool fastOpen = false;
+    };
+
     struct Response final
     {
         Status status;
@@ -178,6 +285,474 @@ namespace http
         std::vector<std::uint8_t> body;
     };
 
+#if defined(__cpp_lib_memory_resource)
+    // The allocator of compact responses and of the header lines collected while parsing them, which allocates
+    // from the given std::pmr::memory_resource (e.g. a per-request std::pmr::monotonic_buffer_resource)
+    using ResponseAllocator = std::pmr::polymorphic_allocator<std::byte>;
+#else
+    using ResponseAllocator = std::allocator<std::byte>;
+#endif // defined(__cpp_lib_memory_resource)
+
+    inline namespace detail
+    {
+        class ResponseParser;
+
+        template <class T>
+        using ResponseVector = std::vector<T, typename std::allocator_traits<ResponseAllocator>::template rebind_alloc<T>>;
+
+        using ResponseString = std::basic_string<char, std::char_traits<char>,
+                                                 typename std::allocator_traits<ResponseAllocator>::template rebind_alloc<char>>;
+
+        constexpr char toLower(const char c) noexcept
+        {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - ('A' - 'a')) : c;
+        }
+
+        // compares a name in any case to a lowercase one
+        constexpr bool equalsLowercase(const std::string_view name, const std::string_view lowercaseName) noexcept
+        {
+            if (name.size() != lowercaseName.size()) return false;
+
+            for (std::size_t i = 0; i < name.size(); ++i)
+                if (toLower(name[i]) != lowercaseName[i])
+                    return false;
+
+            return true;
+        }
+
+        // the lowercase names of the header IDs
+        inline constexpr std::array<std::string_view, static_cast<std::size_t>(HeaderId::xFrameOptions) + 1> headerNames{
+            "",
+            "accept-ranges",
+            "access-control-allow-origin",
+            "age",
+            "alt-svc",
+            "cache-control",
+            "connection",
+            "content-disposition",
+            "content-encoding",
+            "content-language",
+            "content-length",
+            "content-location",
+            "content-range",
+            "content-security-policy",
+            "content-type",
+            "date",
+            "etag",
+            "expires",
+            "keep-alive",
+            "last-modified",
+            "link",
+            "location",
+            "pragma",
+            "proxy-authenticate",
+            "retry-after",
+            "server",
+            "set-cookie",
+            "strict-transport-security",
+            "trailer",
+            "transfer-encoding",
+            "upgrade",
+            "vary",
+            "via",
+            "www-authenticate",
+            "x-content-type-options",
+            "x-frame-options"
+        };
+
+        // Case-insensitive hash of the header name, which maps every name in headerNames to a different slot.
+        // The factors were found by a search over the names, so they must be checked again if a name is added.
+        constexpr std::size_t hashHeaderName(const std::string_view name) noexcept
+        {
+            return (name.size() +
+                    static_cast<unsigned char>(toLower(name.front())) +
+                    static_cast<unsigned char>(toLower(name.back())) * 22U +
+                    static_cast<unsigned char>(toLower(name[name.size() / 2])) * 5U) & 127U;
+        }
+
+        constexpr std::array<HeaderId, 128> makeHeaderIdTable()
+        {
+            std::array<HeaderId, 128> result{};
+
+            for (std::size_t id = 1; id < headerNames.size(); ++id)
+            {
+                auto& entry = result[hashHeaderName(headerNames[id])];
+                // fails the compilation if the hash is not perfect
+                if (entry != HeaderId::unknown)
+                    throw std::logic_error{"Header name hash collision"};
+
+                entry = static_cast<HeaderId>(id);
+            }
+
+            return result;
+        }
+
+        inline constexpr std::array<HeaderId, 128> headerIdTable = makeHeaderIdTable();
+    }
+
+    // returns the ID of the header field name in any case, or HeaderId::unknown if it's not a common one
+    constexpr HeaderId getHeaderId(const std::string_view name) noexcept
+    {
+        if (name.empty()) return HeaderId::unknown;
+
+        const auto id = headerIdTable[hashHeaderName(name)];
+        return equalsLowercase(name, headerNames[static_cast<std::size_t>(id)]) ? id : HeaderId::unknown;
+    }
+
+    // The header fields of a response kept in the received header section, the names and the values are slices of it,
+    // so that a response doesn't need a pair of strings for every header field. The names are lowercased and
+    // the values are unfolded in place. The slices are valid as long as the block is neither modified nor destroyed.
+    class HeaderBlock final
+    {
+        struct Field final
+        {
+            std::size_t nameOffset;
+            std::size_t nameSize;
+            std::size_t valueOffset;
+            std::size_t valueSize;
+            HeaderId id;
+            std::size_t next; // the index + 1 of the next field with the same ID, 0 if there is none
+        };
+
+    public:
+        using value_type = std::pair<std::string_view, std::string_view>;
+
+        class const_iterator final
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = HeaderBlock::value_type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            const_iterator() noexcept = default;
+
+            value_type operator*() const noexcept { return block->getField(*field); }
+
+            const_iterator& operator++() noexcept
+            {
+                ++field;
+                return *this;
+            }
+
+            const_iterator operator++(int) noexcept
+            {
+                const auto result = *this;
+                ++field;
+                return result;
+            }
+
+            bool operator==(const const_iterator& other) const noexcept { return field == other.field; }
+            bool operator!=(const const_iterator& other) const noexcept { return field != other.field; }
+
+        private:
+            friend HeaderBlock;
+
+            const_iterator(const HeaderBlock* headerBlock, const ResponseVector<Field>::const_iterator i) noexcept:
+                block{headerBlock}, field{i}
+            {
+            }
+
+            const HeaderBlock* block = nullptr;
+            ResponseVector<Field>::const_iterator field{};
+        };
+
+        HeaderBlock() = default;
+
+        explicit HeaderBlock(const ResponseAllocator& allocator):
+            block{allocator},
+            fields{allocator}
+        {
+        }
+
+        const_iterator begin() const noexcept { return {this, fields.begin()}; }
+        const_iterator end() const noexcept { return {this, fields.end()}; }
+
+        std::size_t size() const noexcept { return fields.size(); }
+        bool empty() const noexcept { return fields.empty(); }
+
+        value_type operator[](const std::size_t index) const noexcept { return getField(fields[index]); }
+
+        // the values of all the header fields with one ID in the order they were received
+        class Values final
+        {
+        public:
+            class const_iterator final
+            {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = std::string_view;
+                using difference_type = std::ptrdiff_t;
+                using pointer = void;
+                using reference = value_type;
+
+                const_iterator() noexcept = default;
+
+                value_type operator*() const noexcept { return block->getField(block->fields[field - 1]).second; }
+
+                const_iterator& operator++() noexcept
+                {
+                    field = block->fields[field - 1].next;
+                    return *this;
+                }
+
+                const_iterator operator++(int) noexcept
+                {
+                    const auto result = *this;
+                    ++*this;
+                    return result;
+                }
+
+                bool operator==(const const_iterator& other) const noexcept { return field == other.field; }
+                bool operator!=(const const_iterator& other) const noexcept { return field != other.field; }
+
+            private:
+                friend Values;
+
+                const_iterator(const HeaderBlock* headerBlock, const std::size_t first) noexcept:
+                    block{headerBlock}, field{first}
+                {
+                }
+
+                const HeaderBlock* block = nullptr;
+                std::size_t field = 0; // index + 1, 0 at the end
+            };
+
+            const_iterator begin() const noexcept { return {block, first}; }
+            const_iterator end() const noexcept { return {block, 0}; }
+
+            bool empty() const noexcept { return first == 0; }
+
+        private:
+            friend HeaderBlock;
+
+            Values(const HeaderBlock* headerBlock, const std::size_t firstField) noexcept:
+                block{headerBlock}, first{firstField}
+            {
+            }
+
+            const HeaderBlock* block;
+            std::size_t first;
+        };
+
+        // returns the values of all the header fields with the ID, which is empty for HeaderId::unknown
+        Values findAll(const HeaderId id) const noexcept
+        {
+            return {this, (id == HeaderId::unknown) ? 0 : firstFields[static_cast<std::size_t>(id)]};
+        }
+
+        // returns the value of the first header field with the ID in constant time
+        std::optional<std::string_view> find(const HeaderId id) const noexcept
+        {
+            const auto values = findAll(id);
+            if (values.empty()) return std::nullopt;
+            return *values.begin();
+        }
+
+        // returns the value of the first header field with the name in any case,
+        // common names are found by their ID and the others by comparing all the names
+        std::optional<std::string_view> find(const std::string_view name) const noexcept
+        {
+            if (const auto id = getHeaderId(name); id != HeaderId::unknown)
+                return find(id);
+
+            for (const auto& field : fields)
+                if (field.id == HeaderId::unknown && equalsLowercase(name, getField(field).first))
+                    return getField(field).second;
+
+            return std::nullopt;
+        }
+
+    private:
+        friend ResponseParser;
+
+        value_type getField(const Field& field) const noexcept
+        {
+            const std::string_view data = block;
+            return {data.substr(field.nameOffset, field.nameSize), data.substr(field.valueOffset, field.valueSize)};
+        }
+
+        ResponseString block;
+        ResponseVector<Field> fields;
+        // the index + 1 of the first field with each ID, 0 if there is none
+        std::array<std::size_t, headerNames.size()> firstFields{};
+    };
+
+    // A response with the header fields in a HeaderBlock, the header section and the body
+    // are allocated with the given allocator
+    struct CompactResponse final
+    {
+        CompactResponse() = default;
+
+        explicit CompactResponse(const ResponseAllocator& allocator):
+            headerFields{allocator},
+            body{allocator}
+        {
+        }
+
+        Status status;
+        HeaderBlock headerFields;
+        ResponseVector<std::uint8_t> body;
+    };
+
+    // A request body that is sent straight from a file without reading it into memory,
+    // the part of the file from the offset to its end is sent if no length is given
+    class FileBody final
+    {
+    public:
+        explicit FileBody(const std::string& path,
+                          const std::uint64_t rangeOffset = 0,
+                          const std::optional<std::uint64_t> length = std::nullopt):
+            descriptor{openFile(path)},
+            owned{true}
+        {
+            try
+            {
+                setRange(rangeOffset, length);
+            }
+            catch (...)
+            {
+                closeFile(descriptor);
+                throw;
+            }
+        }
+
+        // the file descriptor is not closed by the body and must stay open while the body is used
+        explicit FileBody(const int fileDescriptor,
+                          const std::uint64_t rangeOffset = 0,
+                          const std::optional<std::uint64_t> length = std::nullopt):
+            descriptor{fileDescriptor}
+        {
+            setRange(rangeOffset, length);
+        }
+
+        ~FileBody()
+        {
+            if (owned) closeFile(descriptor);
+        }
+
+        FileBody(const FileBody&) = delete;
+        FileBody& operator=(const FileBody&) = delete;
+
+        FileBody(FileBody&& other) noexcept:
+            descriptor{other.descriptor},
+            owned{other.owned},
+            offset{other.offset},
+            size{other.size}
+        {
+            other.owned = false;
+        }
+
+        FileBody& operator=(FileBody&& other) noexcept
+        {
+            if (&other == this) return *this;
+            if (owned) closeFile(descriptor);
+            descriptor = other.descriptor;
+            owned = other.owned;
+            offset = other.offset;
+            size = other.size;
+            other.owned = false;
+            return *this;
+        }
+
+        int getDescriptor() const noexcept
+        {
+            return descriptor;
+        }
+
+        std::uint64_t getOffset() const noexcept
+        {
+            return offset;
+        }
+
+        std::uint64_t getSize() const noexcept
+        {
+            return size;
+        }
+
+    private:
+        static int openFile(const std::string& path)
+        {
+#if defined(_WIN32)
+            const auto result = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+            auto result = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            while (result == -1 && errno == EINTR)
+                result = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif // defined(_WIN32)
+            if (result == -1)
+                throw std::system_error{errno, std::generic_category(), "Failed to open file"};
+
+            return result;
+        }
+
+        static void closeFile(const int fileDescriptor) noexcept
+        {
+#if defined(_WIN32)
+            _close(fileDescriptor);
+#else
+            ::close(fileDescriptor);
+#endif // defined(_WIN32)
+        }
+
+        void setRange(const std::uint64_t rangeOffset, const std::optional<std::uint64_t> length)
+        {
+            // the Content-Length is taken from the size of the file
+#if defined(_WIN32)
+            struct _stat64 status;
+            if (_fstat64(descriptor, &status) == -1)
+                throw std::system_error{errno, std::generic_category(), "Failed to get file status"};
+
+            if ((status.st_mode & _S_IFMT) != _S_IFREG)
+                throw RequestError{"Only regular files can be sent"};
+#else
+            struct stat status;
+            if (::fstat(descriptor, &status) == -1)
+                throw std::system_error{errno, std::generic_category(), "Failed to get file status"};
+
+            if (!S_ISREG(status.st_mode))
+                throw RequestError{"Only regular files can be sent"};
+#endif // defined(_WIN32)
+
+            const auto fileSize = static_cast<std::uint64_t>(status.st_size);
+            if (rangeOffset > fileSize)
+                throw RequestError{"Offset is past the end of the file"};
+
+            if (length && *length > fileSize - rangeOffset)
+                throw RequestError{"Length is past the end of the file"};
+
+            offset = rangeOffset;
+            size = length ? *length : fileSize - rangeOffset;
+        }
+
+        int descriptor = -1;
+        bool owned = false;
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+    };
+
+    // Callbacks for consuming a response while it is being received, any of them can be empty.
+    // The body is passed to dataReceived in pieces as they arrive (with the chunked transfer coding removed)
+    // and Response::body is left empty, so that large or endless responses don't have to fit into memory.
+    struct ResponseSink final
+    {
+        std::function<void(const Status& status, const HeaderFields& headerFields)> headersReceived;
+        std::function<void(const std::uint8_t* data, std::size_t size)> dataReceived;
+        // finer grained events, called as the status line and each header field are parsed
+        std::function<void(const Status& status)> statusReceived;
+        std::function<void(const HeaderField& headerField)> headerFieldReceived;
+    };
+
+    // A request body of unknown size that is pulled from the producer while the request is being sent
+    // and transferred with the chunked transfer coding (RFC 7230, 4.1. Chunked Transfer Coding).
+    // The producer fills the buffer with at most size bytes and returns their count, 0 ends the body.
+    // Requests with a chunked body are never retried, because the body can't be produced again.
+    struct ChunkedBody final
+    {
+        std::function<std::size_t(std::uint8_t* buffer, std::size_t size)> producer;
+    };
+
     inline namespace detail
     {
 #if defined(_WIN32) || defined(__CYGWIN__)
@@ -344,9 +919,16 @@ namespace http
         {
             return (internetProtocol == InternetProtocol::v4) ? AF_INET :
                 (internetProtocol == InternetProtocol::v6) ? AF_INET6 :
+                (internetProtocol == InternetProtocol::any) ? AF_UNSPEC :
                 throw RequestError{"Unsupported protocol"};
         }
 
+        struct ConstBuffer final
+        {
+            const void* data;
+            std::size_t size;
+        };
+
         class Socket final
         {
         public:
@@ -358,8 +940,13 @@ namespace http
             static constexpr Type invalid = -1;
 #endif // defined(_WIN32) || defined(__CYGWIN__)
 
-            explicit Socket(const InternetProtocol internetProtocol):
-                endpoint{socket(getAddressFamily(internetProtocol), SOCK_STREAM, IPPROTO_TCP)}
+            explicit Socket(const InternetProtocol internetProtocol, const SocketOptions& options = {}):
+                Socket{getAddressFamily(internetProtocol), options}
+            {
+            }
+
+            explicit Socket(const int addressFamily, const SocketOptions& options = {}):
+                endpoint{socket(addressFamily, SOCK_STREAM, IPPROTO_TCP)}
             {
                 if (endpoint == invalid)
 #if defined(_WIN32) || defined(__CYGWIN__)
@@ -398,6 +985,16 @@ namespace http
                     throw std::system_error{errno, std::system_category(), "Failed to set socket option"};
                 }
 #endif // __APPLE__
+
+                try
+                {
+                    setOptions(addressFamily, options);
+                }
+                catch (...)
+                {
+                    close();
+                    throw;
+                }
             }
 
             ~Socket()
@@ -420,6 +1017,13 @@ namespace http
 
             void connect(const struct sockaddr* address, const socklen_t addressSize, const std::int64_t timeout)
             {
+                if (!beginConnect(address, addressSize))
+                    finishConnect(timeout);
+            }
+
+            // starts a non-blocking connect, returns false if the connection is still in progress
+            bool beginConnect(const struct sockaddr* address, const socklen_t addressSize)
+            {
 #if defined(_WIN32) || defined(__CYGWIN__)
                 auto result = ::connect(endpoint, address, addressSize);
                 while (result == -1 && WSAGetLastError() == WSAEINTR)
@@ -428,20 +1032,7 @@ namespace http
                 if (result == -1)
                 {
                     if (WSAGetLastError() == WSAEWOULDBLOCK)
-                    {
-                        select(SelectType::write, timeout);
-
-                        char socketErrorPointer[sizeof(int)];
-                        socklen_t optionLength = sizeof(socketErrorPointer);
-                        if (getsockopt(endpoint, SOL_SOCKET, SO_ERROR, socketErrorPointer, &optionLength) == SOCKET_ERROR)
-                            throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to get socket option"};
-
-                        int socketError;
-                        std::memcpy(&socketError, socketErrorPointer, sizeof(socketErrorPointer));
-
-                        if (socketError != 0)
-                            throw std::system_error{socketError, winsock::errorCategory, "Failed to connect"};
-                    }
+                        return false;
                     else
                         throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to connect"};
                 }
@@ -453,78 +1044,395 @@ namespace http
                 if (result == -1)
                 {
                     if (errno == EINPROGRESS)
-                    {
-                        select(SelectType::write, timeout);
-
-                        int socketError;
-                        socklen_t optionLength = sizeof(socketError);
-                        if (getsockopt(endpoint, SOL_SOCKET, SO_ERROR, &socketError, &optionLength) == -1)
-                            throw std::system_error{errno, std::system_category(), "Failed to get socket option"};
-
-                        if (socketError != 0)
-                            throw std::system_error{socketError, std::system_category(), "Failed to connect"};
-                    }
+                        return false;
                     else
                         throw std::system_error{errno, std::system_category(), "Failed to connect"};
                 }
 #endif // defined(_WIN32) || defined(__CYGWIN__)
+
+                return true;
             }
 
-            std::size_t send(const void* buffer, const std::size_t length, const std::int64_t timeout)
+#if defined(MSG_FASTOPEN)
+            // RFC 7413, TCP Fast Open
+            // Starts connecting and sends as much of the data as fits in the SYN if a cookie from the server is cached,
+            // returns the number of bytes sent or nullopt if the kernel doesn't support Fast Open
+            std::optional<std::size_t> beginConnectFastOpen(const struct sockaddr* address,
+                                                            const socklen_t addressSize,
+                                                            const void* buffer,
+                                                            const std::size_t length)
             {
-                select(SelectType::write, timeout);
-#if defined(_WIN32) || defined(__CYGWIN__)
-                auto result = ::send(endpoint, reinterpret_cast<const char*>(buffer),
-                                     static_cast<int>(length), 0);
-
-                while (result == SOCKET_ERROR && WSAGetLastError() == WSAEINTR)
-                    result = ::send(endpoint, reinterpret_cast<const char*>(buffer),
-                                    static_cast<int>(length), 0);
-
-                if (result == SOCKET_ERROR)
-                    throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to send data"};
-#else
-                auto result = ::send(endpoint, reinterpret_cast<const char*>(buffer),
-                                     length, noSignal);
-
+                auto result = ::sendto(endpoint, reinterpret_cast<const char*>(buffer), length,
+                                       MSG_FASTOPEN | noSignal, address, addressSize);
                 while (result == -1 && errno == EINTR)
-                    result = ::send(endpoint, reinterpret_cast<const char*>(buffer),
-                                    length, noSignal);
+                    result = ::sendto(endpoint, reinterpret_cast<const char*>(buffer), length,
+                                      MSG_FASTOPEN | noSignal, address, addressSize);
 
                 if (result == -1)
-                    throw std::system_error{errno, std::system_category(), "Failed to send data"};
-#endif // defined(_WIN32) || defined(__CYGWIN__)
+                {
+                    if (errno == EINPROGRESS) // the SYN was sent without data
+                        return 0;
+                    else if (errno == EOPNOTSUPP)
+                        return std::nullopt;
+                    else
+                        throw std::system_error{errno, std::system_category(), "Failed to connect"};
+                }
+
                 return static_cast<std::size_t>(result);
             }
+#endif // defined(MSG_FASTOPEN)
 
-            std::size_t recv(void* buffer, const std::size_t length, const std::int64_t timeout)
+            // waits for a connect started with beginConnect to finish
+            void finishConnect(const std::int64_t timeout)
+            {
+                select(SelectType::write, timeout);
+                finishConnect();
+            }
+
+            // checks the result of a connect started with beginConnect once the socket has become writable
+            void finishConnect()
             {
-                select(SelectType::read, timeout);
 #if defined(_WIN32) || defined(__CYGWIN__)
-                auto result = ::recv(endpoint, reinterpret_cast<char*>(buffer),
-                                     static_cast<int>(length), 0);
+                char socketErrorPointer[sizeof(int)];
+                socklen_t optionLength = sizeof(socketErrorPointer);
+                if (getsockopt(endpoint, SOL_SOCKET, SO_ERROR, socketErrorPointer, &optionLength) == SOCKET_ERROR)
+                    throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to get socket option"};
 
-                while (result == SOCKET_ERROR && WSAGetLastError() == WSAEINTR)
-                    result = ::recv(endpoint, reinterpret_cast<char*>(buffer),
-                                    static_cast<int>(length), 0);
+                int socketError;
+                std::memcpy(&socketError, socketErrorPointer, sizeof(socketErrorPointer));
 
-                if (result == SOCKET_ERROR)
-                    throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to read data"};
+                if (socketError != 0)
+                    throw std::system_error{socketError, winsock::errorCategory, "Failed to connect"};
 #else
-                auto result = ::recv(endpoint, reinterpret_cast<char*>(buffer),
-                                     length, noSignal);
-
-                while (result == -1 && errno == EINTR)
-                    result = ::recv(endpoint, reinterpret_cast<char*>(buffer),
-                                    length, noSignal);
+                int socketError;
+                socklen_t optionLength = sizeof(socketError);
+                if (getsockopt(endpoint, SOL_SOCKET, SO_ERROR, &socketError, &optionLength) == -1)
+                    throw std::system_error{errno, std::system_category(), "Failed to get socket option"};
+
+                if (socketError != 0)
+                    throw std::system_error{socketError, std::system_category(), "Failed to connect"};
+#endif // defined(_WIN32) || defined(__CYGWIN__)
+            }
+
+            std::size_t send(const void* buffer, const std::size_t length, const std::int64_t timeout)
+            {
+                for (;;)
+                {
+                    select(SelectType::write, timeout);
+                    if (const auto result = trySend(buffer, length))
+                        return *result;
+                }
+            }
+
+            std::size_t send(const ConstBuffer* buffers, const std::size_t count, const std::int64_t timeout)
+            {
+                for (;;)
+                {
+                    select(SelectType::write, timeout);
+                    if (const auto result = trySend(buffers, count))
+                        return *result;
+                }
+            }
+
+            std::size_t sendFile(const int file, const std::uint64_t offset, const std::size_t length, const std::int64_t timeout)
+            {
+                for (;;)
+                {
+                    select(SelectType::write, timeout);
+                    if (const auto result = trySendFile(file, offset, length))
+                        return *result;
+                }
+            }
+
+            // reads the data that is already available without polling first, so that a busy connection
+            // takes one system call per read
+            std::size_t recv(void* buffer, const std::size_t length, const std::int64_t timeout)
+            {
+                for (;;)
+                {
+                    if (const auto result = tryRecv(buffer, length))
+                        return *result;
+                    select(SelectType::read, timeout);
+                }
+            }
+
+            // sends without waiting, returns nullopt if the socket's send buffer is full
+            std::optional<std::size_t> trySend(const void* buffer, const std::size_t length)
+            {
+#if defined(_WIN32) || defined(__CYGWIN__)
+                auto result = ::send(endpoint, reinterpret_cast<const char*>(buffer),
+                                     static_cast<int>(length), 0);
+
+                while (result == SOCKET_ERROR && WSAGetLastError() == WSAEINTR)
+                    result = ::send(endpoint, reinterpret_cast<const char*>(buffer),
+                                    static_cast<int>(length), 0);
+
+                if (result == SOCKET_ERROR)
+                {
+                    if (WSAGetLastError() == WSAEWOULDBLOCK)
+                        return std::nullopt;
+                    else
+                        throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to send data"};
+                }
+#else
+                auto result = ::send(endpoint, reinterpret_cast<const char*>(buffer),
+                                     length, noSignal);
+
+                while (result == -1 && errno == EINTR)
+                    result = ::send(endpoint, reinterpret_cast<const char*>(buffer),
+                                    length, noSignal);
+
+                if (result == -1)
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        return std::nullopt;
+                    else
+                        throw std::system_error{errno, std::system_category(), "Failed to send data"};
+                }
+#endif // defined(_WIN32) || defined(__CYGWIN__)
+                return static_cast<std::size_t>(result);
+            }
+
+            // sends the buffers in order with one system call without waiting (scatter-gather I/O),
+            // returns nullopt if no data can be sent without blocking
+            std::optional<std::size_t> trySend(const ConstBuffer* buffers, std::size_t count)
+            {
+#if defined(_WIN32) || defined(__CYGWIN__)
+                std::array<WSABUF, 4> vectors;
+                count = (std::min)(count, vectors.size());
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    vectors[i].len = static_cast<ULONG>(buffers[i].size);
+                    vectors[i].buf = const_cast<CHAR*>(reinterpret_cast<const CHAR*>(buffers[i].data));
+                }
+
+                DWORD sent = 0;
+                auto result = WSASend(endpoint, vectors.data(), static_cast<DWORD>(count), &sent, 0, nullptr, nullptr);
+
+                while (result == SOCKET_ERROR && WSAGetLastError() == WSAEINTR)
+                    result = WSASend(endpoint, vectors.data(), static_cast<DWORD>(count), &sent, 0, nullptr, nullptr);
+
+                if (result == SOCKET_ERROR)
+                {
+                    if (WSAGetLastError() == WSAEWOULDBLOCK)
+                        return std::nullopt;
+                    else
+                        throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to send data"};
+                }
+
+                return static_cast<std::size_t>(sent);
+#else
+                std::array<iovec, 4> vectors;
+                count = (std::min)(count, vectors.size());
+                for (std::size_t i = 0; i < count; ++i)
+                    vectors[i] = iovec{const_cast<void*>(buffers[i].data), buffers[i].size};
+
+                msghdr message{};
+                message.msg_iov = vectors.data();
+                message.msg_iovlen = count;
+
+                auto result = ::sendmsg(endpoint, &message, noSignal);
+
+                while (result == -1 && errno == EINTR)
+                    result = ::sendmsg(endpoint, &message, noSignal);
+
+                if (result == -1)
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        return std::nullopt;
+                    else
+                        throw std::system_error{errno, std::system_category(), "Failed to send data"};
+                }
+
+                return static_cast<std::size_t>(result);
+#endif // defined(_WIN32) || defined(__CYGWIN__)
+            }
+
+            // sends a part of a file without waiting, returns nullopt if the socket's send buffer is full,
+            // the data is copied from the page cache by sendfile on Linux and read in small blocks elsewhere
+            std::optional<std::size_t> trySendFile(const int file, const std::uint64_t offset, const std::size_t length)
+            {
+#if defined(__linux__)
+                auto position = static_cast<off_t>(offset);
+
+                // sendfile has no MSG_NOSIGNAL flag, so SIGPIPE is held back while it runs
+                const SignalPipeGuard signalPipeGuard;
+                auto result = ::sendfile(endpoint, file, &position, length);
+
+                while (result == -1 && errno == EINTR)
+                    result = ::sendfile(endpoint, file, &position, length);
+
+                if (result == -1)
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        return std::nullopt;
+                    else
+                        throw std::system_error{errno, std::system_category(), "Failed to send file"};
+                }
+
+                const auto sent = static_cast<std::size_t>(result);
+#else
+                std::array<char, 16384> buffer;
+                const auto blockSize = static_cast<unsigned int>((std::min)(length, buffer.size()));
+#  if defined(_WIN32)
+                if (_lseeki64(file, static_cast<__int64>(offset), SEEK_SET) == -1)
+                    throw std::system_error{errno, std::generic_category(), "Failed to read file"};
+
+                const auto size = _read(file, buffer.data(), blockSize);
+#  else
+                auto size = ::pread(file, buffer.data(), blockSize, static_cast<off_t>(offset));
+
+                while (size == -1 && errno == EINTR)
+                    size = ::pread(file, buffer.data(), blockSize, static_cast<off_t>(offset));
+#  endif // defined(_WIN32)
+                if (size == -1)
+                    throw std::system_error{errno, std::generic_category(), "Failed to read file"};
+
+                std::size_t sent = 0;
+                if (size > 0)
+                {
+                    // the part that didn't fit into the send buffer is read again on the next call
+                    const auto result = trySend(buffer.data(), static_cast<std::size_t>(size));
+                    if (!result) return std::nullopt;
+                    sent = *result;
+                }
+#endif // defined(__linux__)
+                if (sent == 0 && length > 0)
+                    throw RequestError{"File ended before the end of the body"};
+
+                return sent;
+            }
+
+#if defined(__linux__)
+            // moves up to length bytes to the pipe without copying them to user space,
+            // returns 0 if the peer has disconnected
+            std::size_t splice(const int pipe, const std::size_t length, const std::int64_t timeout)
+            {
+                for (;;)
+                {
+                    select(SelectType::read, timeout);
+
+                    auto result = ::splice(endpoint, nullptr, pipe, nullptr, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+                    while (result == -1 && errno == EINTR)
+                        result = ::splice(endpoint, nullptr, pipe, nullptr, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+                    if (result == -1)
+                    {
+                        if (errno == EAGAIN || errno == EWOULDBLOCK)
+                            continue;
+                        else
+                            throw std::system_error{errno, std::system_category(), "Failed to read data"};
+                    }
+
+                    return static_cast<std::size_t>(result);
+                }
+            }
+#endif // defined(__linux__)
+
+            // receives without waiting, returns nullopt if there is no data available and 0 if the peer has disconnected
+            std::optional<std::size_t> tryRecv(void* buffer, const std::size_t length)
+            {
+#if defined(_WIN32) || defined(__CYGWIN__)
+                auto result = ::recv(endpoint, reinterpret_cast<char*>(buffer),
+                                     static_cast<int>(length), 0);
+
+                while (result == SOCKET_ERROR && WSAGetLastError() == WSAEINTR)
+                    result = ::recv(endpoint, reinterpret_cast<char*>(buffer),
+                                    static_cast<int>(length), 0);
+
+                if (result == SOCKET_ERROR)
+                {
+                    if (WSAGetLastError() == WSAEWOULDBLOCK)
+                        return std::nullopt;
+                    else
+                        throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to read data"};
+                }
+#else
+                auto result = ::recv(endpoint, reinterpret_cast<char*>(buffer),
+                                     length, noSignal);
+
+                while (result == -1 && errno == EINTR)
+                    result = ::recv(endpoint, reinterpret_cast<char*>(buffer),
+                                    length, noSignal);
 
                 if (result == -1)
-                    throw std::system_error{errno, std::system_category(), "Failed to read data"};
+                {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK)
+                        return std::nullopt;
+                    else
+                        throw std::system_error{errno, std::system_category(), "Failed to read data"};
+                }
 #endif // defined(_WIN32) || defined(__CYGWIN__)
                 return static_cast<std::size_t>(result);
             }
 
+            Type getHandle() const noexcept
+            {
+                return endpoint;
+            }
+
+            // checks whether an idle connection can still be used for sending a request
+            // (the peer has neither closed it nor sent any unexpected data)
+            bool isIdle()
+            {
+                return !poll(SelectType::read, 0);
+            }
+
         private:
+            void setOptions(const int addressFamily, const SocketOptions& options)
+            {
+                if (options.noDelay) setOption(IPPROTO_TCP, TCP_NODELAY, 1);
+                if (options.receiveBufferSize > 0) setOption(SOL_SOCKET, SO_RCVBUF, options.receiveBufferSize);
+                if (options.sendBufferSize > 0) setOption(SOL_SOCKET, SO_SNDBUF, options.sendBufferSize);
+
+                if (options.keepAlive)
+                {
+                    setOption(SOL_SOCKET, SO_KEEPALIVE, 1);
+#if defined(TCP_KEEPIDLE)
+                    if (options.keepAliveIdle.count() > 0)
+                        setOption(IPPROTO_TCP, TCP_KEEPIDLE, static_cast<int>(options.keepAliveIdle.count()));
+#elif defined(TCP_KEEPALIVE)
+                    if (options.keepAliveIdle.count() > 0)
+                        setOption(IPPROTO_TCP, TCP_KEEPALIVE, static_cast<int>(options.keepAliveIdle.count()));
+#endif // defined(TCP_KEEPIDLE)
+#if defined(TCP_KEEPINTVL)
+                    if (options.keepAliveInterval.count() > 0)
+                        setOption(IPPROTO_TCP, TCP_KEEPINTVL, static_cast<int>(options.keepAliveInterval.count()));
+#endif // defined(TCP_KEEPINTVL)
+#if defined(TCP_KEEPCNT)
+                    if (options.keepAliveCount > 0)
+                        setOption(IPPROTO_TCP, TCP_KEEPCNT, options.keepAliveCount);
+#endif // defined(TCP_KEEPCNT)
+                }
+
+#if defined(SO_PRIORITY)
+                if (options.priority >= 0) setOption(SOL_SOCKET, SO_PRIORITY, options.priority);
+#endif // defined(SO_PRIORITY)
+
+                if (options.typeOfService >= 0)
+                {
+#if defined(IPV6_TCLASS)
+                    if (addressFamily == AF_INET6)
+                        setOption(IPPROTO_IPV6, IPV6_TCLASS, options.typeOfService);
+                    else
+#endif // defined(IPV6_TCLASS)
+                    if (addressFamily == AF_INET)
+                        setOption(IPPROTO_IP, IP_TOS, options.typeOfService);
+                }
+            }
+
+            void setOption(const int level, const int name, const int value)
+            {
+#if defined(_WIN32) || defined(__CYGWIN__)
+                if (setsockopt(endpoint, level, name, reinterpret_cast<const char*>(&value), sizeof(value)) == SOCKET_ERROR)
+                    throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to set socket option"};
+#else
+                if (setsockopt(endpoint, level, name, &value, sizeof(value)) == -1)
+                    throw std::system_error{errno, std::system_category(), "Failed to set socket option"};
+#endif // defined(_WIN32) || defined(__CYGWIN__)
+            }
+
             enum class SelectType
             {
                 read,
@@ -533,11 +1441,17 @@ namespace http
 
             void select(const SelectType type, const std::int64_t timeout)
             {
+                if (!poll(type, timeout))
+                    throw ResponseError{"Request timed out"};
+            }
+
+            bool poll(const SelectType type, const std::int64_t timeout)
+            {
+#if defined(_WIN32) || defined(__CYGWIN__)
                 fd_set descriptorSet;
                 FD_ZERO(&descriptorSet);
                 FD_SET(endpoint, &descriptorSet);
 
-#if defined(_WIN32) || defined(__CYGWIN__)
                 TIMEVAL selectTimeout{
                     static_cast<LONG>(timeout / 1000),
                     static_cast<LONG>((timeout % 1000) * 1000)
@@ -557,31 +1471,21 @@ namespace http
 
                 if (count == SOCKET_ERROR)
                     throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to select socket"};
-                else if (count == 0)
-                    throw ResponseError{"Request timed out"};
 #else
-                timeval selectTimeout{
-                    static_cast<time_t>(timeout / 1000),
-                    static_cast<suseconds_t>((timeout % 1000) * 1000)
-                };
-                auto count = ::select(endpoint + 1,
-                                      (type == SelectType::read) ? &descriptorSet : nullptr,
-                                      (type == SelectType::write) ? &descriptorSet : nullptr,
-                                      nullptr,
-                                      (timeout >= 0) ? &selectTimeout : nullptr);
+                // poll instead of select, because select can't handle descriptors above FD_SETSIZE
+                pollfd descriptor{endpoint, static_cast<short>((type == SelectType::read) ? POLLIN : POLLOUT), 0};
+                const auto pollTimeout = (timeout >= 0) ? static_cast<int>((std::min)(timeout, std::int64_t{INT32_MAX})) : -1;
+
+                auto count = ::poll(&descriptor, 1, pollTimeout);
 
                 while (count == -1 && errno == EINTR)
-                    count = ::select(endpoint + 1,
-                                     (type == SelectType::read) ? &descriptorSet : nullptr,
-                                     (type == SelectType::write) ? &descriptorSet : nullptr,
-                                     nullptr,
-                                     (timeout >= 0) ? &selectTimeout : nullptr);
+                    count = ::poll(&descriptor, 1, pollTimeout);
 
                 if (count == -1)
-                    throw std::system_error{errno, std::system_category(), "Failed to select socket"};
-                else if (count == 0)
-                    throw ResponseError{"Request timed out"};
+                    throw std::system_error{errno, std::system_category(), "Failed to poll socket"};
 #endif // defined(_WIN32) || defined(__CYGWIN__)
+
+                return count != 0;
             }
 
             void close() noexcept
@@ -599,14 +1503,51 @@ namespace http
             static constexpr int noSignal = 0;
 #endif // defined(__unix__) && !defined(__APPLE__)
 
+#if defined(__linux__)
+            // blocks SIGPIPE in the calling thread and discards it if it was raised while the guard was alive
+            class SignalPipeGuard final
+            {
+            public:
+                SignalPipeGuard() noexcept
+                {
+                    sigemptyset(&signals);
+                    sigaddset(&signals, SIGPIPE);
+
+                    sigset_t pendingSignals;
+                    sigemptyset(&pendingSignals);
+                    sigpending(&pendingSignals);
+                    pending = (sigismember(&pendingSignals, SIGPIPE) == 1);
+
+                    pthread_sigmask(SIG_BLOCK, &signals, &previousSignals);
+                }
+
+                ~SignalPipeGuard()
+                {
+                    const auto error = errno;
+
+                    if (!pending)
+                    {
+                        const timespec noWait{0, 0};
+                        while (sigtimedwait(&signals, nullptr, &noWait) == -1 && errno == EINTR);
+                    }
+
+                    pthread_sigmask(SIG_SETMASK, &previousSignals, nullptr);
+                    errno = error;
+                }
+
+                SignalPipeGuard(const SignalPipeGuard&) = delete;
+                SignalPipeGuard& operator=(const SignalPipeGuard&) = delete;
+
+            private:
+                sigset_t signals;
+                sigset_t previousSignals;
+                bool pending = false; // a SIGPIPE raised before the guard was created is left for the application
+            };
+#endif // defined(__linux__)
+
             Type endpoint = invalid;
         };
 
-        inline char toLower(const char c) noexcept
-        {
-            return (c >= 'A' && c <= 'Z') ? c - ('A' - 'a') : c;
-        }
-
         template <class T>
         T toLower(const T& s)
         {
@@ -638,29 +1579,6 @@ namespace http
                 (c >= 0x41 && c <= 0x5A); // A - Z
         }
 
-        // RFC 7230, 3.2.6. Field Value Components
-        template <typename C>
-        constexpr bool isTokenChar(const C c) noexcept
-        {
-            return c == 0x21 || // !
-                c == 0x23 || // #
-                c == 0x24 || // $
-                c == 0x25 || // %
-                c == 0x26 || // &
-                c == 0x27 || // '
-                c == 0x2A || // *
-                c == 0x2B || // +
-                c == 0x2D || // -
-                c == 0x2E || // .
-                c == 0x5E || // ^
-                c == 0x5F || // _
-                c == 0x60 || // `
-                c == 0x7C || // |
-                c == 0x7E || // ~
-                isDigitChar(c) ||
-                isAlphaChar(c);
-        };
-
         // RFC 5234, Appendix B.1. Core Rules
         template <typename C>
         constexpr bool isVisibleChar(const C c) noexcept
@@ -676,55 +1594,206 @@ namespace http
                 static_cast<unsigned char>(c) <= 0xFF;
         }
 
-        template <class Iterator>
-        Iterator skipWhiteSpaces(const Iterator begin, const Iterator end)
+        constexpr std::uint8_t tokenCharClass = 0x01;
+        constexpr std::uint8_t fieldValueCharClass = 0x02;
+
+        // classes of all the byte values, so that a character is classified with one lookup
+        constexpr std::array<std::uint8_t, 256> makeCharacterClasses() noexcept
         {
-            auto i = begin;
-            for (i = begin; i != end; ++i)
-                if (!isWhiteSpaceChar(*i))
-                    break;
+            std::array<std::uint8_t, 256> result{};
 
-            return i;
+            for (unsigned int c = 0; c < result.size(); ++c)
+            {
+                // RFC 7230, 3.2.6. Field Value Components
+                if (c == 0x21 || // !
+                    c == 0x23 || // #
+                    c == 0x24 || // $
+                    c == 0x25 || // %
+                    c == 0x26 || // &
+                    c == 0x27 || // '
+                    c == 0x2A || // *
+                    c == 0x2B || // +
+                    c == 0x2D || // -
+                    c == 0x2E || // .
+                    c == 0x5E || // ^
+                    c == 0x5F || // _
+                    c == 0x60 || // `
+                    c == 0x7C || // |
+                    c == 0x7E || // ~
+                    isDigitChar(c) ||
+                    isAlphaChar(c))
+                    result[c] |= tokenCharClass;
+
+                // RFC 7230, 3.2. Header Fields
+                if (isWhiteSpaceChar(c) || isVisibleChar(c) || c >= 0x80)
+                    result[c] |= fieldValueCharClass;
+            }
+
+            return result;
         }
 
-        // RFC 5234, Appendix B.1. Core Rules
-        template <typename T, typename C, typename std::enable_if<std::is_unsigned<T>::value>::type* = nullptr>
-        constexpr T digitToUint(const C c)
+        inline constexpr std::array<std::uint8_t, 256> characterClasses = makeCharacterClasses();
+
+        template <typename C>
+        constexpr std::uint8_t getCharacterClass(const C c) noexcept
         {
-            // DIGIT
-            return (c >= 0x30 && c <= 0x39) ? static_cast<T>(c - 0x30) : // 0 - 9
-                throw ResponseError{"Invalid digit"};
+            if constexpr (sizeof(C) == 1)
+                return characterClasses[static_cast<unsigned char>(c)];
+            else
+                return (static_cast<std::make_unsigned_t<C>>(c) < characterClasses.size()) ?
+                    characterClasses[static_cast<std::make_unsigned_t<C>>(c)] : 0;
         }
 
-        // RFC 5234, Appendix B.1. Core Rules
-        template <typename T, typename C, typename std::enable_if<std::is_unsigned<T>::value>::type* = nullptr>
-        constexpr T hexDigitToUint(const C c)
+        // RFC 7230, 3.2.6. Field Value Components
+        template <typename C>
+        constexpr bool isTokenChar(const C c) noexcept
         {
-            // HEXDIG
-            return (c >= 0x30 && c <= 0x39) ? static_cast<T>(c - 0x30) : // 0 - 9
-                (c >= 0x41 && c <= 0x46) ? static_cast<T>(c - 0x41) + T(10) : // A - Z
-                (c >= 0x61 && c <= 0x66) ? static_cast<T>(c - 0x61) + T(10) : // a - z, some services send lower-case hex digits
-                throw ResponseError{"Invalid hex digit"};
+            return (getCharacterClass(c) & tokenCharClass) != 0;
         }
 
-        // RFC 3986, 3. Syntax Components
-        template <class Iterator>
-        Uri parseUri(const Iterator begin, const Iterator end)
+        // RFC 7230, 3.2. Header Fields
+        template <typename C>
+        constexpr bool isFieldValueChar(const C c) noexcept
         {
-            Uri result;
+            return (getCharacterClass(c) & fieldValueCharClass) != 0;
+        }
 
-            // RFC 3986, 3.1. Scheme
+        // Returns the first byte that can't be a part of a field value (a control character other than HTAB, or DEL).
+        // Field values can be kilobytes long (cookies, content security policies), so they are checked 32 or 16 bytes
+        // at a time with AVX2, SSE2 or NEON, and the exact position is found with the table.
+        inline const std::uint8_t* findInvalidFieldValueChar(const std::uint8_t* begin, const std::uint8_t* end) noexcept
+        {
             auto i = begin;
-            if (i == end || !isAlphaChar(*begin))
-                throw RequestError{"Invalid scheme"};
 
-            result.scheme.push_back(*i++);
+#if defined(__AVX2__)
+            // unsigned data < 0x20 is tested with a signed comparison after flipping the sign bits
+            const auto signBits = _mm256_set1_epi8(static_cast<char>(0x80));
+            const auto space = _mm256_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+            const auto tab = _mm256_set1_epi8(0x09);
+            const auto del = _mm256_set1_epi8(0x7F);
 
-            for (; i != end && (isAlphaChar(*i) || isDigitChar(*i) || *i == '+' || *i == '-' || *i == '.'); ++i)
-                result.scheme.push_back(*i);
+            for (; end - i >= 32; i += 32)
+            {
+                const auto data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i));
+                const auto control = _mm256_cmpgt_epi8(space, _mm256_xor_si256(data, signBits));
+                const auto invalid = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpeq_epi8(data, tab), control),
+                                                     _mm256_cmpeq_epi8(data, del));
+                if (_mm256_movemask_epi8(invalid) != 0) break;
+            }
+#endif // defined(__AVX2__)
 
-            if (i == end || *i++ != ':')
-                throw RequestError{"Invalid scheme"};
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+            const auto signBits128 = _mm_set1_epi8(static_cast<char>(0x80));
+            const auto space128 = _mm_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+            const auto tab128 = _mm_set1_epi8(0x09);
+            const auto del128 = _mm_set1_epi8(0x7F);
+
+            for (; end - i >= 16; i += 16)
+            {
+                const auto data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(i));
+                const auto control = _mm_cmpgt_epi8(space128, _mm_xor_si128(data, signBits128));
+                const auto invalid = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(data, tab128), control),
+                                                  _mm_cmpeq_epi8(data, del128));
+                if (_mm_movemask_epi8(invalid) != 0) break;
+            }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+            const auto space = vdupq_n_u8(0x20);
+            const auto tab = vdupq_n_u8(0x09);
+            const auto del = vdupq_n_u8(0x7F);
+
+            for (; end - i >= 16; i += 16)
+            {
+                const auto data = vld1q_u8(i);
+                const auto invalid = vorrq_u8(vbicq_u8(vcltq_u8(data, space), vceqq_u8(data, tab)),
+                                              vceqq_u8(data, del));
+                if (vmaxvq_u8(invalid) != 0) break;
+            }
+#endif // defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+            for (; i != end; ++i)
+                if (!isFieldValueChar(*i))
+                    return i;
+
+            return end;
+        }
+
+        // iterators over bytes in contiguous memory, which can be scanned with findInvalidFieldValueChar
+        template <class Iterator>
+        constexpr bool isContiguousByteIterator =
+            std::is_same_v<Iterator, const char*> ||
+            std::is_same_v<Iterator, char*> ||
+            std::is_same_v<Iterator, const std::uint8_t*> ||
+            std::is_same_v<Iterator, std::string::const_iterator> ||
+            std::is_same_v<Iterator, std::string::iterator> ||
+            std::is_same_v<Iterator, ResponseString::const_iterator> ||
+            std::is_same_v<Iterator, ResponseString::iterator> ||
+            std::is_same_v<Iterator, std::vector<std::uint8_t>::const_iterator> ||
+            std::is_same_v<Iterator, std::vector<std::uint8_t>::iterator>;
+
+        // RFC 7230, 3.2. Header Fields
+        template <class Iterator>
+        Iterator findFieldValueEnd(const Iterator begin, const Iterator end)
+        {
+            if constexpr (isContiguousByteIterator<Iterator>)
+            {
+                if (begin == end) return end;
+
+                const auto data = reinterpret_cast<const std::uint8_t*>(&*begin);
+                return begin + (findInvalidFieldValueChar(data, data + (end - begin)) - data);
+            }
+            else
+                return std::find_if(begin, end, [](const auto c) noexcept { return !isFieldValueChar(c); });
+        }
+
+        template <class Iterator>
+        Iterator skipWhiteSpaces(const Iterator begin, const Iterator end)
+        {
+            auto i = begin;
+            for (i = begin; i != end; ++i)
+                if (!isWhiteSpaceChar(*i))
+                    break;
+
+            return i;
+        }
+
+        // RFC 5234, Appendix B.1. Core Rules
+        template <typename T, typename C, typename std::enable_if<std::is_unsigned<T>::value>::type* = nullptr>
+        constexpr T digitToUint(const C c)
+        {
+            // DIGIT
+            return (c >= 0x30 && c <= 0x39) ? static_cast<T>(c - 0x30) : // 0 - 9
+                throw ResponseError{"Invalid digit"};
+        }
+
+        // RFC 5234, Appendix B.1. Core Rules
+        template <typename T, typename C, typename std::enable_if<std::is_unsigned<T>::value>::type* = nullptr>
+        constexpr T hexDigitToUint(const C c)
+        {
+            // HEXDIG
+            return (c >= 0x30 && c <= 0x39) ? static_cast<T>(c - 0x30) : // 0 - 9
+                (c >= 0x41 && c <= 0x46) ? static_cast<T>(c - 0x41) + T(10) : // A - Z
+                (c >= 0x61 && c <= 0x66) ? static_cast<T>(c - 0x61) + T(10) : // a - z, some services send lower-case hex digits
+                throw ResponseError{"Invalid hex digit"};
+        }
+
+        // RFC 3986, 3. Syntax Components
+        template <class Iterator>
+        Uri parseUri(const Iterator begin, const Iterator end)
+        {
+            Uri result;
+
+            // RFC 3986, 3.1. Scheme
+            auto i = begin;
+            if (i == end || !isAlphaChar(*begin))
+                throw RequestError{"Invalid scheme"};
+
+            result.scheme.push_back(*i++);
+
+            for (; i != end && (isAlphaChar(*i) || isDigitChar(*i) || *i == '+' || *i == '-' || *i == '.'); ++i)
+                result.scheme.push_back(*i);
+
+            if (i == end || *i++ != ':')
+                throw RequestError{"Invalid scheme"};
             if (i == end || *i++ != '/')
                 throw RequestError{"Invalid scheme"};
             if (i == end || *i++ != '/')
@@ -793,6 +1862,33 @@ namespace http
             return result;
         }
 
+        // RFC 3986, 4.2. Relative Reference
+        // Only absolute-path references ("/path?query") are resolved against the base,
+        // anything else is parsed as a full URI
+        inline Uri parseUriReference(const Uri& base, const std::string& reference)
+        {
+            if (reference.empty() || reference.front() != '/' ||
+                (reference.size() > 1 && reference[1] == '/')) // network-path reference
+                return parseUri(reference.begin(), reference.end());
+
+            Uri result = base;
+            std::string path = reference;
+
+            // RFC 3986, 3.5. Fragment
+            const auto fragmentPosition = path.find('#');
+            result.fragment = (fragmentPosition != std::string::npos) ? path.substr(fragmentPosition + 1) : "";
+            if (fragmentPosition != std::string::npos) path.resize(fragmentPosition);
+
+            // RFC 3986, 3.4. Query
+            const auto queryPosition = path.find('?');
+            result.query = (queryPosition != std::string::npos) ? path.substr(queryPosition + 1) : "";
+            if (queryPosition != std::string::npos) path.resize(queryPosition);
+
+            result.path = std::move(path);
+
+            return result;
+        }
+
         // RFC 7230, 2.6. Protocol Versioning
         template <class Iterator>
         std::pair<Iterator, Version> parseVersion(const Iterator begin, const Iterator end)
@@ -846,40 +1942,28 @@ namespace http
         template <class Iterator>
         std::pair<Iterator, std::string> parseReasonPhrase(const Iterator begin, const Iterator end)
         {
-            std::string result;
-
-            auto i = begin;
-            for (; i != end && (isWhiteSpaceChar(*i) || isVisibleChar(*i) || isObsoleteTextChar(*i)); ++i)
-                result.push_back(static_cast<char>(*i));
-
-            return {i, std::move(result)};
+            const auto i = findFieldValueEnd(begin, end);
+            return {i, std::string(begin, i)};
         }
 
         // RFC 7230, 3.2.6. Field Value Components
         template <class Iterator>
         std::pair<Iterator, std::string> parseToken(const Iterator begin, const Iterator end)
         {
-            std::string result;
-
-            auto i = begin;
-            for (; i != end && isTokenChar(*i); ++i)
-                result.push_back(static_cast<char>(*i));
+            const auto i = std::find_if(begin, end, [](const auto c) noexcept { return !isTokenChar(c); });
 
-            if (result.empty())
+            if (i == begin)
                 throw ResponseError{"Invalid token"};
 
-            return {i, std::move(result)};
+            return {i, std::string(begin, i)};
         }
 
         // RFC 7230, 3.2. Header Fields
         template <class Iterator>
         std::pair<Iterator, std::string> parseFieldValue(const Iterator begin, const Iterator end)
         {
-            std::string result;
-
-            auto i = begin;
-            for (; i != end && (isWhiteSpaceChar(*i) || isVisibleChar(*i) || isObsoleteTextChar(*i)); ++i)
-                result.push_back(static_cast<char>(*i));
+            const auto i = findFieldValueEnd(begin, end);
+            std::string result(begin, i);
 
             // trim white spaces
             result.erase(std::find_if(result.rbegin(), result.rend(), [](const char c) noexcept {
@@ -1016,13 +2100,12 @@ namespace http
                 if (headerField.first.empty())
                     throw RequestError{"Invalid header field name"};
 
-                for (const auto c : headerField.first)
-                    if (!isTokenChar(c))
-                        throw RequestError{"Invalid header field name"};
+                if (!std::all_of(headerField.first.begin(), headerField.first.end(),
+                                 [](const char c) noexcept { return isTokenChar(c); }))
+                    throw RequestError{"Invalid header field name"};
 
-                for (const auto c : headerField.second)
-                    if (!isWhiteSpaceChar(c) && !isVisibleChar(c) && !isObsoleteTextChar(c))
-                        throw RequestError{"Invalid header field value"};
+                if (findFieldValueEnd(headerField.second.begin(), headerField.second.end()) != headerField.second.end())
+                    throw RequestError{"Invalid header field value"};
 
                 result += headerField.first + ": " + headerField.second + "\r\n";
             }
@@ -1077,10 +2160,12 @@ namespace http
             return result;
         }
 
-        inline std::vector<std::uint8_t> encodeHtml(const Uri& uri,
-                                                    const std::string& method,
-                                                    const std::vector<uint8_t>& body,
-                                                    HeaderFields headerFields)
+        // encodes the request line and the header fields of a request with a body of the given size,
+        // the body is sent in chunks if its size is not known
+        inline std::string encodeRequestHead(const Uri& uri,
+                                             const std::string& method,
+                                             const std::optional<std::size_t> bodySize,
+                                             HeaderFields headerFields)
         {
             if (uri.scheme != "http")
                 throw RequestError{"Only HTTP scheme is supported"};
@@ -1091,8 +2176,16 @@ namespace http
             // RFC 7230, 5.4. Host
             headerFields.push_back({"Host", uri.host});
 
-            // RFC 7230, 3.3.2. Content-Length
-            headerFields.push_back({"Content-Length", std::to_string(body.size())});
+            if (bodySize)
+            {
+                // RFC 7230, 3.3.2. Content-Length
+                headerFields.push_back({"Content-Length", std::to_string(*bodySize)});
+            }
+            else
+            {
+                // RFC 7230, 3.3.1. Transfer-Encoding
+                headerFields.push_back({"Transfer-Encoding", "chunked"});
+            }
 
             // RFC 7617, 2. The 'Basic' Authentication Scheme
             if (!uri.user.empty() || !uri.password.empty())
@@ -1101,230 +2194,4270 @@ namespace http
                 headerFields.push_back({"Authorization", "Basic " + encodeBase64(userinfo.begin(), userinfo.end())});
             }
 
-            const auto headerData = encodeRequestLine(method, requestTarget) +
+            return encodeRequestLine(method, requestTarget) +
                 encodeHeaderFields(headerFields) +
                 "\r\n";
+        }
+
+        inline std::vector<std::uint8_t> encodeHtml(const Uri& uri,
+                                                    const std::string& method,
+                                                    const std::vector<uint8_t>& body,
+                                                    const HeaderFields& headerFields)
+        {
+            const auto headerData = encodeRequestHead(uri, method, body.size(), headerFields);
 
             std::vector<uint8_t> result(headerData.begin(), headerData.end());
             result.insert(result.end(), body.begin(), body.end());
 
             return result;
         }
-    }
 
-    class Request final
-    {
-    public:
-        explicit Request(const std::string& uriString,
-                         const InternetProtocol protocol = InternetProtocol::v4):
-            internetProtocol{protocol},
-            uri{parseUri(uriString.begin(), uriString.end())}
+        // The encoded head of a request and its body, which is sent straight from the caller's buffer
+        // with scatter-gather I/O instead of being copied after the head (the body must outlive the message)
+        struct RequestMessage final
+        {
+            std::string head;
+            const std::uint8_t* body = nullptr;
+            std::size_t bodySize = 0;
+            int file = -1; // the body is sent from the file with sendFile instead if it is set
+            std::uint64_t fileOffset = 0;
+            const ChunkedBody* chunkedBody = nullptr; // the body is sent in chunks after the head if it is set
+
+            // whether the message can be sent again on a new connection
+            bool isReplayable() const noexcept
+            {
+                return chunkedBody == nullptr;
+            }
+
+            std::size_t size() const noexcept
+            {
+                return head.size() + bodySize;
+            }
+
+            // fills in the parts of the message after the offset and returns their count
+            std::size_t getBuffers(const std::size_t offset, std::array<ConstBuffer, 2>& buffers) const noexcept
+            {
+                std::size_t count = 0;
+                if (offset < head.size())
+                    buffers[count++] = ConstBuffer{head.data() + offset, head.size() - offset};
+
+                const auto bodyOffset = (offset > head.size()) ? offset - head.size() : 0;
+                if (file == -1 && bodyOffset < bodySize)
+                    buffers[count++] = ConstBuffer{body + bodyOffset, bodySize - bodyOffset};
+
+                return count;
+            }
+        };
+
+        inline RequestMessage encodeRequest(const Uri& uri,
+                                            const std::string& method,
+                                            const std::vector<uint8_t>& body,
+                                            const HeaderFields& headerFields)
         {
+            return RequestMessage{encodeRequestHead(uri, method, body.size(), headerFields), body.data(), body.size()};
         }
 
-        Response send(const std::string& method = "GET",
-                      const std::string& body = "",
-                      const HeaderFields& headerFields = {},
-                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        inline RequestMessage encodeRequest(const Uri& uri,
+                                            const std::string& method,
+                                            const std::string& body,
+                                            const HeaderFields& headerFields)
         {
-            return send(method,
-                        std::vector<uint8_t>(body.begin(), body.end()),
-                        headerFields,
-                        timeout);
+            return RequestMessage{encodeRequestHead(uri, method, body.size(), headerFields),
+                                  reinterpret_cast<const std::uint8_t*>(body.data()), body.size()};
         }
 
-        Response send(const std::string& method,
-                      const std::vector<uint8_t>& body,
-                      const HeaderFields& headerFields = {},
-                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        inline RequestMessage encodeRequest(const Uri& uri,
+                                            const std::string& method,
+                                            const FileBody& body,
+                                            const HeaderFields& headerFields)
         {
-            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+            if (body.getSize() > (std::numeric_limits<std::size_t>::max)())
+                throw RequestError{"File is too big"};
 
-            if (uri.scheme != "http")
-                throw RequestError{"Only HTTP scheme is supported"};
+            const auto bodySize = static_cast<std::size_t>(body.getSize());
 
-            addrinfo hints = {};
-            hints.ai_family = getAddressFamily(internetProtocol);
-            hints.ai_socktype = SOCK_STREAM;
+            RequestMessage result{encodeRequestHead(uri, method, bodySize, headerFields), nullptr, bodySize};
+            result.file = body.getDescriptor();
+            result.fileOffset = body.getOffset();
+            return result;
+        }
 
-            const char* port = uri.port.empty() ? "80" : uri.port.c_str();
+        inline RequestMessage encodeRequest(const Uri& uri,
+                                            const std::string& method,
+                                            const ChunkedBody& body,
+                                            const HeaderFields& headerFields)
+        {
+            if (!body.producer)
+                throw RequestError{"Chunked body has no producer"};
 
-            addrinfo* info;
-            if (getaddrinfo(uri.host.c_str(), port, &hints, &info) != 0)
-#if defined(_WIN32) || defined(__CYGWIN__)
-                throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to get address info of " + uri.host};
-#else
-                throw std::system_error{errno, std::system_category(), "Failed to get address info of " + uri.host};
-#endif // defined(_WIN32) || defined(__CYGWIN__)
+            RequestMessage result{encodeRequestHead(uri, method, std::nullopt, headerFields)};
+            result.chunkedBody = &body;
+            return result;
+        }
 
-            const std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> addressInfo{info, freeaddrinfo};
+        // RFC 7231, 6.3. Successful 2xx
+        inline bool isSuccessfulStatus(const Status& status) noexcept
+        {
+            return status.code >= 200 && status.code < 300;
+        }
 
-            const auto requestData = encodeHtml(uri, method, body, headerFields);
+        // RFC 7231, 4.2.2. Idempotent Methods
+        inline bool isIdempotentMethod(const std::string& method) noexcept
+        {
+            return method == "GET" ||
+                method == "HEAD" ||
+                method == "OPTIONS" ||
+                method == "TRACE" ||
+                method == "PUT" ||
+                method == "DELETE";
+        }
 
-            Socket socket{internetProtocol};
+        // RFC 7230, 6.1. Connection
+        template <class HeaderFieldRange = HeaderFields>
+        bool hasConnectionOption(const HeaderFieldRange& headerFields, const std::string& option)
+        {
+            for (const auto& headerField : headerFields)
+                if (headerField.first == "connection")
+                {
+                    // Connection = 1#connection-option, connection options are case-insensitive
+                    const auto& value = headerField.second;
+                    auto i = value.begin();
+                    while (i != value.end())
+                    {
+                        i = skipWhiteSpaces(i, value.end());
+                        const auto optionEnd = std::find(i, value.end(), ',');
+                        auto optionValueEnd = optionEnd;
+                        while (optionValueEnd != i && isWhiteSpaceChar(*(optionValueEnd - 1))) --optionValueEnd;
 
-            const auto getRemainingMilliseconds = [](const std::chrono::steady_clock::time_point time) noexcept -> std::int64_t {
-                const auto now = std::chrono::steady_clock::now();
-                const auto remainingTime = std::chrono::duration_cast<std::chrono::milliseconds>(time - now);
-                return (remainingTime.count() > 0) ? remainingTime.count() : 0;
-            };
+                        if (toLower(std::string(i, optionValueEnd)) == option)
+                            return true;
 
-            // take the first address from the list
-            socket.connect(addressInfo->ai_addr, static_cast<socklen_t>(addressInfo->ai_addrlen),
-                           (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
+                        i = (optionEnd == value.end()) ? optionEnd : optionEnd + 1;
+                    }
+                }
 
-            auto remaining = requestData.size();
-            auto sendData = requestData.data();
+            return false;
+        }
 
-            // send the request
-            while (remaining > 0)
-            {
-                const auto size = socket.send(sendData, remaining,
-                                              (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
-                remaining -= size;
-                sendData += size;
-            }
+        // RFC 7230, 6.3. Persistence
+        template <class HeaderFieldRange>
+        bool isPersistentConnection(const Status& status, const HeaderFieldRange& headerFields)
+        {
+            if (hasConnectionOption(headerFields, "close"))
+                return false;
 
-            std::array<std::uint8_t, 4096> tempBuffer;
-            constexpr std::array<std::uint8_t, 2> crlf = {'\r', '\n'};
-            constexpr std::array<std::uint8_t, 4> headerEnd = {'\r', '\n', '\r', '\n'};
-            Response response;
-            std::vector<std::uint8_t> responseData;
-            bool parsingBody = false;
-            bool contentLengthReceived = false;
-            std::size_t contentLength = 0U;
-            bool chunkedResponse = false;
-            std::size_t expectedChunkSize = 0U;
-            bool removeCrlfAfterChunk = false;
+            // HTTP/1.1 connections are persistent by default, HTTP/1.0 ones only with the keep-alive option
+            if (status.version.major > 1 ||
+                (status.version.major == 1 && status.version.minor >= 1))
+                return true;
 
-            // read the response
-            for (;;)
-            {
-                const auto size = socket.recv(tempBuffer.data(), tempBuffer.size(),
-                                              (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
-                if (size == 0) // disconnected
-                    return response;
+            return hasConnectionOption(headerFields, "keep-alive");
+        }
 
-                responseData.insert(responseData.end(), tempBuffer.begin(), tempBuffer.begin() + size);
+        inline bool isPersistentConnection(const Response& response)
+        {
+            return isPersistentConnection(response.status, response.headerFields);
+        }
 
-                if (!parsingBody)
+        // RFC 2068, 19.7.1.1. The Keep-Alive Header
+        template <class HeaderFieldRange = HeaderFields>
+        std::optional<std::chrono::seconds> getKeepAliveTimeout(const HeaderFieldRange& headerFields)
+        {
+            for (const auto& headerField : headerFields)
+                if (headerField.first == "keep-alive")
                 {
-                    // RFC 7230, 3. Message Format
-                    // Empty line indicates the end of the header section (RFC 7230, 2.1. Client/Server Messaging)
-                    const auto endIterator = std::search(responseData.cbegin(), responseData.cend(),
-                                                         headerEnd.cbegin(), headerEnd.cend());
-                    if (endIterator == responseData.cend()) break; // two consecutive CRLFs not found
+                    const auto& value = headerField.second;
+                    auto i = value.begin();
+                    while (i != value.end())
+                    {
+                        i = skipWhiteSpaces(i, value.end());
+                        const auto parameterEnd = std::find(i, value.end(), ',');
+                        const auto separator = std::find(i, parameterEnd, '=');
+                        auto nameEnd = separator;
+                        while (nameEnd != i && isWhiteSpaceChar(*(nameEnd - 1))) --nameEnd;
 
-                    const auto headerBeginIterator = responseData.cbegin();
-                    const auto headerEndIterator = endIterator + 2;
+                        if (separator != parameterEnd && toLower(std::string(i, nameEnd)) == "timeout")
+                        {
+                            const auto valueBegin = skipWhiteSpaces(separator + 1, parameterEnd);
+                            auto valueEnd = valueBegin;
+                            while (valueEnd != parameterEnd && isDigitChar(*valueEnd)) ++valueEnd;
 
-                    auto statusLineResult = parseStatusLine(headerBeginIterator, headerEndIterator);
-                    auto i = statusLineResult.first;
+                            // ignore malformed values, the server will close the connection anyway
+                            if (valueBegin != valueEnd && valueEnd - valueBegin <= 9)
+                                return std::chrono::seconds{stringToUint<std::uint32_t>(valueBegin, valueEnd)};
+                        }
 
-                    response.status = std::move(statusLineResult.second);
+                        i = (parameterEnd == value.end()) ? parameterEnd : parameterEnd + 1;
+                    }
+                }
 
-                    for (;;)
-                    {
-                        auto headerFieldResult = parseHeaderField(i, headerEndIterator);
-                        i = headerFieldResult.first;
+            return std::nullopt;
+        }
 
-                        auto fieldName = std::move(headerFieldResult.second.first);
-                        auto fieldValue = std::move(headerFieldResult.second.second);
+        inline std::int64_t getRemainingMilliseconds(const std::chrono::steady_clock::time_point time) noexcept
+        {
+            const auto now = std::chrono::steady_clock::now();
+            const auto remainingTime = std::chrono::duration_cast<std::chrono::milliseconds>(time - now);
+            return (remainingTime.count() > 0) ? remainingTime.count() : 0;
+        }
 
-                        if (fieldName == "transfer-encoding")
-                        {
-                            // RFC 7230, 3.3.1. Transfer-Encoding
-                            if (fieldValue == "chunked")
-                                chunkedResponse = true;
-                            else
-                                throw ResponseError{"Unsupported transfer encoding: " + fieldValue};
-                        }
-                        else if (fieldName == "content-length")
-                        {
-                            // RFC 7230, 3.3.2. Content-Length
-                            contentLength = stringToUint<std::size_t>(fieldValue.cbegin(), fieldValue.cend());
-                            contentLengthReceived = true;
-                            response.body.reserve(contentLength);
-                        }
+        struct Connection final
+        {
+            explicit Connection(Socket s) noexcept:
+                socket{std::move(s)}
+            {
+            }
 
-                        response.headerFields.push_back({std::move(fieldName), std::move(fieldValue)});
+            // checks whether the connection can be reused for the next request
+            bool isReusable()
+            {
+                return persistent &&
+                    std::chrono::steady_clock::now() < expiryTime &&
+                    socket.isIdle();
+            }
 
-                        if (i == headerEndIterator)
-                            break;
-                    }
+            Socket socket;
+            bool persistent = false;
+            std::chrono::steady_clock::time_point expiryTime = std::chrono::steady_clock::time_point::max();
+        };
 
-                    responseData.erase(responseData.cbegin(), headerEndIterator + 2);
-                    parsingBody = true;
-                }
+        struct Address final
+        {
+            int family;
+            sockaddr_storage storage;
+            socklen_t size;
+        };
 
-                if (parsingBody)
-                {
-                    // Content-Length must be ignored if Transfer-Encoding is received (RFC 7230, 3.2. Content-Length)
-                    if (chunkedResponse)
-                    {
-                        // RFC 7230, 4.1. Chunked Transfer Coding
-                        for (;;)
-                        {
-                            if (expectedChunkSize > 0)
-                            {
-                                const auto toWrite = (std::min)(expectedChunkSize, responseData.size());
-                                response.body.insert(response.body.end(), responseData.begin(),
-                                                     responseData.begin() + static_cast<std::ptrdiff_t>(toWrite));
-                                responseData.erase(responseData.begin(),
-                                                   responseData.begin() + static_cast<std::ptrdiff_t>(toWrite));
-                                expectedChunkSize -= toWrite;
-
-                                if (expectedChunkSize == 0) removeCrlfAfterChunk = true;
-                                if (responseData.empty()) break;
-                            }
-                            else
-                            {
-                                if (removeCrlfAfterChunk)
-                                {
-                                    if (responseData.size() < 2) break;
-                                    
-                                    if (!std::equal(crlf.begin(), crlf.end(), responseData.begin()))
-                                        throw ResponseError{"Invalid chunk"};
+        // blocking lookup with getaddrinfo
+        inline std::vector<Address> lookupAddresses(const std::string& host,
+                                                    const std::string& port,
+                                                    const InternetProtocol internetProtocol,
+                                                    const int flags = 0)
+        {
+            addrinfo hints = {};
+            hints.ai_family = getAddressFamily(internetProtocol);
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = flags;
+
+            addrinfo* info;
+            if (getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0)
+#if defined(_WIN32) || defined(__CYGWIN__)
+                throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to get address info of " + host};
+#else
+                throw std::system_error{errno, std::system_category(), "Failed to get address info of " + host};
+#endif // defined(_WIN32) || defined(__CYGWIN__)
 
-                                    removeCrlfAfterChunk = false;
-                                    responseData.erase(responseData.begin(), responseData.begin() + 2);
-                                }
+            const std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> addressInfo{info, freeaddrinfo};
 
-                                const auto i = std::search(responseData.begin(), responseData.end(),
-                                                           crlf.begin(), crlf.end());
+            std::vector<Address> result;
+            for (auto i = addressInfo.get(); i; i = i->ai_next)
+            {
+                if (i->ai_addrlen > sizeof(sockaddr_storage)) continue;
 
-                                if (i == responseData.end()) break;
+                Address address{};
+                address.family = i->ai_family;
+                std::memcpy(&address.storage, i->ai_addr, i->ai_addrlen);
+                address.size = static_cast<socklen_t>(i->ai_addrlen);
+                result.push_back(address);
+            }
 
-                                expectedChunkSize = detail::hexStringToUint<std::size_t>(responseData.begin(), i);
-                                responseData.erase(responseData.begin(), i + 2);
+            return result;
+        }
 
-                                if (expectedChunkSize == 0)
-                                    return response;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        response.body.insert(response.body.end(), responseData.begin(), responseData.end());
-                        responseData.clear();
+        // Runs jobs (mostly blocking getaddrinfo calls) on a small set of worker threads which are started on demand
+        // and exit after being idle for a while. The workers are detached and share the state with the pool,
+        // so a lookup that is stuck in the system resolver never blocks the caller or the program exit.
+        // A worker whose job has run past its deadline doesn't count towards the worker limit, so lookups that
+        // are stuck in the system resolver (until its own timeout, which can be tens of seconds) can't starve
+        // the following ones; the number of threads is then bounded only by the number of stuck lookups.
+        class LookupPool final
+        {
+        public:
+            explicit LookupPool(const std::size_t maxWorkers):
+                state{std::make_shared<State>(maxWorkers)}
+            {
+            }
+
+            // the deadline is the time after which nobody waits for the result of the job anymore
+            void post(std::function<void()> job,
+                      const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+            {
+                {
+                    std::lock_guard<std::mutex> lock{state->mutex};
+                    state->jobs.push_back(Job{std::move(job), deadline});
+
+                    const auto stuckWorkerCount = static_cast<std::size_t>(std::distance(state->runningDeadlines.begin(),
+                                                                                         state->runningDeadlines.upper_bound(std::chrono::steady_clock::now())));
 
-                        // got the whole content
-                        if (contentLengthReceived && response.body.size() >= contentLength)
-                            return response;
+                    if (state->idleWorkerCount < state->jobs.size() &&
+                        state->workerCount < state->maxWorkerCount + stuckWorkerCount)
+                    {
+                        std::thread{work, state}.detach();
+                        ++state->workerCount;
                     }
                 }
+
+                state->condition.notify_one();
             }
 
-            return response;
-        }
+            // changes the number of workers that run jobs at the same time, the running workers are not stopped
+            void setMaxWorkerCount(const std::size_t maxWorkers)
+            {
+                std::lock_guard<std::mutex> lock{state->mutex};
+                state->maxWorkerCount = maxWorkers;
+            }
 
-    private:
-#if defined(_WIN32) || defined(__CYGWIN__)
+        private:
+            struct Job final
+            {
+                std::function<void()> function;
+                std::chrono::steady_clock::time_point deadline;
+            };
+
+            struct State final
+            {
+                explicit State(const std::size_t maxWorkers) noexcept:
+                    maxWorkerCount{maxWorkers}
+                {
+                }
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+                winsock::Api winSock;
+#endif // defined(_WIN32) || defined(__CYGWIN__)
+                std::mutex mutex;
+                std::condition_variable condition;
+                std::deque<Job> jobs;
+                std::multiset<std::chrono::steady_clock::time_point> runningDeadlines;
+                std::size_t maxWorkerCount;
+                std::size_t workerCount = 0;
+                std::size_t idleWorkerCount = 0;
+            };
+
+            static void work(const std::shared_ptr<State> state)
+            {
+                std::unique_lock<std::mutex> lock{state->mutex};
+
+                for (;;)
+                {
+                    ++state->idleWorkerCount;
+                    const auto hasJob = state->condition.wait_for(lock, std::chrono::seconds{30}, [&state]() noexcept {
+                        return !state->jobs.empty();
+                    });
+                    --state->idleWorkerCount;
+
+                    if (!hasJob) break;
+
+                    auto job = std::move(state->jobs.front());
+                    state->jobs.pop_front();
+                    const auto running = state->runningDeadlines.insert(job.deadline);
+
+                    lock.unlock();
+                    job.function();
+                    lock.lock();
+
+                    state->runningDeadlines.erase(running);
+                }
+
+                --state->workerCount;
+            }
+
+            std::shared_ptr<State> state;
+        };
+
+        inline LookupPool& getLookupPool()
+        {
+            static LookupPool lookupPool{8};
+            return lookupPool;
+        }
+
+        // sets the number of host name lookups that run at the same time (8 by default), not counting the lookups
+        // that are stuck past their timeout
+        inline void setMaxLookupThreads(const std::size_t count)
+        {
+            getLookupPool().setMaxWorkerCount(count);
+        }
+
+        inline std::future<std::vector<Address>> resolveAsync(const std::string& host,
+                                                              const std::string& port,
+                                                              const InternetProtocol internetProtocol,
+                                                              const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max())
+        {
+            auto task = std::make_shared<std::packaged_task<std::vector<Address>()>>([host, port, internetProtocol]() {
+                return lookupAddresses(host, port, internetProtocol);
+            });
+            auto result = task->get_future();
+            getLookupPool().post([task]() { (*task)(); }, deadline);
+            return result;
+        }
+
+        // Runs the lookup on the lookup pool, so that a slow resolver can't block the caller past the timeout,
+        // lookups without a timeout are run on the calling thread
+        template <class Lookup>
+        std::vector<Address> lookupWithTimeout(Lookup lookup, const std::int64_t timeout)
+        {
+            if (timeout < 0)
+                return lookup();
+
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{timeout};
+            auto task = std::make_shared<std::packaged_task<std::vector<Address>()>>(std::move(lookup));
+            auto result = task->get_future();
+            getLookupPool().post([task]() { (*task)(); }, deadline);
+            if (result.wait_until(deadline) != std::future_status::ready)
+                throw ResponseError{"Request timed out"};
+
+            return result.get();
+        }
+
+        // Resolves the host on the lookup pool, so that a slow system resolver can't block the caller past the timeout.
+        // Numeric addresses and lookups without a timeout are resolved on the calling thread.
+        inline std::vector<Address> resolve(const std::string& host,
+                                            const std::string& port,
+                                            const InternetProtocol internetProtocol,
+                                            const std::int64_t timeout)
+        {
+            try
+            {
+                return lookupAddresses(host, port, internetProtocol, AI_NUMERICHOST);
+            }
+            catch (const std::system_error&)
+            {
+            }
+
+            return lookupWithTimeout([host, port, internetProtocol]() {
+                return lookupAddresses(host, port, internetProtocol);
+            }, timeout);
+        }
+
+        // RFC 8305, 4. Sorting Addresses
+        // Alternates the address families, starting with the family of the most preferred address
+        // while keeping the order within each family
+        inline std::vector<Address> interleaveAddresses(const std::vector<Address>& addresses)
+        {
+            if (addresses.empty()) return addresses;
+
+            const auto firstFamily = addresses.front().family;
+            std::vector<Address> first;
+            std::vector<Address> second;
+            for (const auto& address : addresses)
+                (address.family == firstFamily ? first : second).push_back(address);
+
+            std::vector<Address> result;
+            result.reserve(addresses.size());
+            for (std::size_t i = 0; i < (std::max)(first.size(), second.size()); ++i)
+            {
+                if (i < first.size()) result.push_back(first[i]);
+                if (i < second.size()) result.push_back(second[i]);
+            }
+
+            return result;
+        }
+
+        // RFC 8305, 8. Implementation Considerations, recommended Connection Attempt Delay
+        constexpr std::int64_t connectionAttemptDelay = 250;
+
+        // RFC 8305, 5. Connection Attempts
+        // Starts a new connection attempt every connectionAttemptDelay milliseconds (or as soon as the previous
+        // attempt fails) and returns the first socket that connects.
+        // The attempts that were already started count as the ones for the addresses before nextAddress.
+        inline Socket connect(const std::vector<Address>& addresses,
+                              std::size_t nextAddress,
+                              std::vector<Socket> attempts,
+                              const std::int64_t timeout,
+                              const SocketOptions& socketOptions)
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + std::chrono::milliseconds{timeout};
+
+            std::exception_ptr lastError;
+            auto nextAttemptTime = std::chrono::steady_clock::now() +
+                std::chrono::milliseconds{attempts.empty() ? 0 : connectionAttemptDelay};
+
+            for (;;)
+            {
+                const auto now = std::chrono::steady_clock::now();
+
+                if (nextAddress < addresses.size() && (attempts.empty() || now >= nextAttemptTime))
+                {
+                    const auto& address = addresses[nextAddress++];
+                    try
+                    {
+                        Socket socket{address.family, socketOptions};
+                        if (socket.beginConnect(reinterpret_cast<const sockaddr*>(&address.storage), address.size))
+                            return socket;
+
+                        attempts.push_back(std::move(socket));
+                        nextAttemptTime = now + std::chrono::milliseconds{connectionAttemptDelay};
+                    }
+                    catch (const std::system_error&)
+                    {
+                        lastError = std::current_exception();
+                    }
+
+                    continue;
+                }
+
+                if (attempts.empty())
+                {
+                    if (lastError) std::rethrow_exception(lastError);
+                    throw ResponseError{"No address to connect to"};
+                }
+
+                std::int64_t waitTime = -1;
+                if (timeout >= 0)
+                {
+                    waitTime = getRemainingMilliseconds(stopTime);
+                    if (waitTime == 0)
+                        throw ResponseError{"Request timed out"};
+                }
+
+                if (nextAddress < addresses.size())
+                {
+                    const auto attemptWaitTime = (std::max)(std::int64_t{0}, static_cast<std::int64_t>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(nextAttemptTime - now).count()));
+                    waitTime = (waitTime >= 0) ? (std::min)(waitTime, attemptWaitTime) : attemptWaitTime;
+                }
+
+                // a connection attempt is finished when the socket becomes writable,
+                // Windows reports failed attempts in the exception set instead
+#if defined(_WIN32) || defined(__CYGWIN__)
+                fd_set writeDescriptorSet;
+                fd_set exceptDescriptorSet;
+                FD_ZERO(&writeDescriptorSet);
+                FD_ZERO(&exceptDescriptorSet);
+
+                for (const auto& socket : attempts)
+                {
+                    FD_SET(socket.getHandle(), &writeDescriptorSet);
+                    FD_SET(socket.getHandle(), &exceptDescriptorSet);
+                }
+
+                TIMEVAL selectTimeout{
+                    static_cast<LONG>(waitTime / 1000),
+                    static_cast<LONG>((waitTime % 1000) * 1000)
+                };
+                auto count = ::select(0, nullptr, &writeDescriptorSet, &exceptDescriptorSet,
+                                      (waitTime >= 0) ? &selectTimeout : nullptr);
+
+                while (count == SOCKET_ERROR && WSAGetLastError() == WSAEINTR)
+                    count = ::select(0, nullptr, &writeDescriptorSet, &exceptDescriptorSet,
+                                     (waitTime >= 0) ? &selectTimeout : nullptr);
+
+                if (count == SOCKET_ERROR)
+                    throw std::system_error{WSAGetLastError(), winsock::errorCategory, "Failed to select socket"};
+
+                const auto isFinished = [&writeDescriptorSet, &exceptDescriptorSet](const Socket& socket) {
+                    return FD_ISSET(socket.getHandle(), &writeDescriptorSet) ||
+                        FD_ISSET(socket.getHandle(), &exceptDescriptorSet);
+                };
+#else
+                std::vector<pollfd> descriptors;
+                for (const auto& socket : attempts)
+                    descriptors.push_back(pollfd{socket.getHandle(), POLLOUT, 0});
+
+                const auto pollTimeout = (waitTime >= 0) ? static_cast<int>((std::min)(waitTime, std::int64_t{INT32_MAX})) : -1;
+
+                auto count = ::poll(descriptors.data(), static_cast<nfds_t>(descriptors.size()), pollTimeout);
+
+                while (count == -1 && errno == EINTR)
+                    count = ::poll(descriptors.data(), static_cast<nfds_t>(descriptors.size()), pollTimeout);
+
+                if (count == -1)
+                    throw std::system_error{errno, std::system_category(), "Failed to poll socket"};
+
+                const auto isFinished = [&descriptors](const Socket& socket) {
+                    for (const auto& descriptor : descriptors)
+                        if (descriptor.fd == socket.getHandle())
+                            return descriptor.revents != 0;
+                    return false;
+                };
+#endif // defined(_WIN32) || defined(__CYGWIN__)
+
+                for (auto i = attempts.begin(); i != attempts.end();)
+                {
+                    if (!isFinished(*i))
+                    {
+                        ++i;
+                        continue;
+                    }
+
+                    try
+                    {
+                        i->finishConnect();
+                        return std::move(*i);
+                    }
+                    catch (const std::system_error&)
+                    {
+                        // start the next attempt right away
+                        lastError = std::current_exception();
+                        nextAttemptTime = std::chrono::steady_clock::now();
+                        i = attempts.erase(i);
+                    }
+                }
+            }
+        }
+
+        inline Socket connect(const std::vector<Address>& addresses,
+                              const std::int64_t timeout,
+                              const SocketOptions& socketOptions = {})
+        {
+            return connect(addresses, 0, {}, timeout, socketOptions);
+        }
+
+        // Resumable parser of a single response, the data can be passed to it in arbitrary pieces.
+        // Every byte is examined once: the header section is collected line by line and parsed when it's complete,
+        // and the body is passed on straight from the input without being buffered.
+        // If a compact response is given, the header fields and the body are stored in it instead of the response,
+        // the sink gets no headerFieldReceived events, and the header section is collected with its allocator.
+        class ResponseParser final
+        {
+        public:
+            explicit ResponseParser(const std::string& requestMethod,
+                                    const ResponseSink* responseSink = nullptr,
+                                    CompactResponse* responseCompactResponse = nullptr):
+                method{requestMethod},
+                sink{responseSink},
+                compactResponse{responseCompactResponse},
+                header{getAllocator()},
+                line{getAllocator()}
+            {
+                // a retried request starts over
+                if (compactResponse) compactResponse->body.clear();
+            }
+
+            // the allocator of the compact response or the default one
+            ResponseAllocator getAllocator() const noexcept
+            {
+                return compactResponse ? ResponseAllocator{compactResponse->body.get_allocator()} : ResponseAllocator{};
+            }
+
+            // Parses the next piece of the response and returns the number of bytes consumed, which is less than
+            // the size only if the response is complete and the data contains bytes after its end
+            std::size_t parse(const std::uint8_t* data, const std::size_t size)
+            {
+                if (state == State::complete) return 0;
+
+                started = true;
+
+                const auto begin = data;
+                const auto end = data + size;
+
+                while (data != end && state != State::complete)
+                {
+                    switch (state)
+                    {
+                        case State::header:
+                        {
+                            // RFC 7230, 3. Message Format
+                            // Empty line indicates the end of the header section (RFC 7230, 2.1. Client/Server Messaging)
+                            if (!readLine(data, end, header)) break;
+
+                            if (header.size() - lineBegin == 2 && header[lineBegin] == '\r')
+                                parseHeader();
+                            else
+                                lineBegin = header.size();
+                            break;
+                        }
+                        case State::body:
+                        {
+                            const auto available = static_cast<std::size_t>(end - data);
+                            const auto toWrite = contentLengthReceived ?
+                                (std::min)(contentLength - bodySize, available) :
+                                available;
+                            writeBody(data, toWrite);
+                            data += toWrite;
+
+                            // got the whole content
+                            if (contentLengthReceived && bodySize >= contentLength)
+                                state = State::complete;
+                            break;
+                        }
+                        // RFC 7230, 4.1. Chunked Transfer Coding
+                        case State::chunkSize:
+                        {
+                            const auto chunkSizeLine = readLine(data, end);
+                            if (!chunkSizeLine) break;
+
+                            expectedChunkSize = parseChunkSize(*chunkSizeLine);
+                            line.clear();
+                            state = (expectedChunkSize == 0) ? State::trailer : State::chunkData;
+                            break;
+                        }
+                        case State::chunkData:
+                        {
+                            const auto toWrite = (std::min)(expectedChunkSize, static_cast<std::size_t>(end - data));
+                            writeBody(data, toWrite);
+                            data += toWrite;
+                            expectedChunkSize -= toWrite;
+
+                            if (expectedChunkSize == 0) state = State::chunkDataEnd;
+                            break;
+                        }
+                        case State::chunkDataEnd:
+                        {
+                            const auto chunkEndLine = readLine(data, end);
+                            if (!chunkEndLine) break;
+
+                            if (chunkEndLine->size() != 2 || chunkEndLine->front() != '\r')
+                                throw ResponseError{"Invalid chunk"};
+
+                            line.clear();
+                            state = State::chunkSize;
+                            break;
+                        }
+                        case State::trailer:
+                        {
+                            // RFC 7230, 4.1.2. Chunked Trailer Part
+                            // trailer fields are skipped until the empty line
+                            const auto trailerLine = readLine(data, end);
+                            if (!trailerLine) break;
+
+                            if (trailerLine->size() < 2 || (*trailerLine)[trailerLine->size() - 2] != '\r')
+                                throw ResponseError{"Invalid chunk"};
+
+                            if (trailerLine->size() == 2) state = State::complete;
+                            line.clear();
+                            break;
+                        }
+                        case State::complete:
+                            break;
+                    }
+                }
+
+                return static_cast<std::size_t>(data - begin);
+            }
+
+            // whether any data has been passed to the parser
+            bool hasStarted() const noexcept { return started; }
+
+            bool isComplete() const noexcept { return state == State::complete; }
+
+            // whether the body has neither a length nor chunks and ends when the connection is closed
+            // (RFC 7230, 3.3.3. Message Body Length)
+            bool isEndedByClose() const noexcept { return state == State::body && !contentLengthReceived; }
+
+            Response& getResponse() noexcept { return response; }
+
+            // the number of body bytes still expected, if the body is not chunked and its length is known
+            std::optional<std::size_t> getRemainingContentLength() const noexcept
+            {
+                if (state != State::body || !contentLengthReceived)
+                    return std::nullopt;
+
+                return contentLength - bodySize;
+            }
+
+            // accounts for body bytes that were received past the parser
+            void skipBody(const std::size_t size) noexcept
+            {
+                bodySize += size;
+                if (contentLengthReceived && bodySize >= contentLength)
+                    state = State::complete;
+            }
+
+        private:
+            enum class State
+            {
+                header,
+                body,
+                chunkSize,
+                chunkData,
+                chunkDataEnd,
+                trailer,
+                complete
+            };
+
+            // appends the data up to and including the next LF to the line,
+            // returns false if the data ended before the end of the line
+            static bool readLine(const std::uint8_t*& data, const std::uint8_t* const end, ResponseString& result)
+            {
+                const auto lineEnd = static_cast<const std::uint8_t*>(std::memchr(data, '\n', static_cast<std::size_t>(end - data)));
+                const auto next = lineEnd ? lineEnd + 1 : end;
+                result.append(data, next);
+                data = next;
+                return lineEnd != nullptr;
+            }
+
+            // returns the next line of the chunked body, which is read in place if the data contains all of it
+            // and collected in the line buffer otherwise, the buffer must be cleared after the line has been used
+            std::optional<std::string_view> readLine(const std::uint8_t*& data, const std::uint8_t* const end)
+            {
+                if (line.empty())
+                    if (const auto lineEnd = static_cast<const std::uint8_t*>(std::memchr(data, '\n', static_cast<std::size_t>(end - data))))
+                    {
+                        const std::string_view result{reinterpret_cast<const char*>(data),
+                                                      static_cast<std::size_t>(lineEnd + 1 - data)};
+                        data = lineEnd + 1;
+                        return result;
+                    }
+
+                if (!readLine(data, end, line)) return std::nullopt;
+                return std::string_view{line};
+            }
+
+            void parseHeader()
+            {
+                if (compactResponse)
+                    parseHeaderBlock();
+                else
+                {
+                    const auto headerEnd = header.cend();
+                    const auto fieldsEnd = headerEnd - 2; // the empty line
+
+                    auto statusLineResult = parseStatusLine(header.cbegin(), headerEnd);
+                    auto i = statusLineResult.first;
+
+                    response.status = std::move(statusLineResult.second);
+                    if (sink && sink->statusReceived) sink->statusReceived(response.status);
+
+                    while (i != fieldsEnd)
+                    {
+                        auto headerFieldResult = parseHeaderField(i, headerEnd);
+                        i = headerFieldResult.first;
+
+                        processHeaderField(getHeaderId(headerFieldResult.second.first), headerFieldResult.second.second);
+
+                        response.headerFields.push_back(std::move(headerFieldResult.second));
+                        if (sink && sink->headerFieldReceived) sink->headerFieldReceived(response.headerFields.back());
+                    }
+
+                    header.clear();
+                    header.shrink_to_fit();
+                }
+
+                if (sink && sink->headersReceived)
+                    sink->headersReceived(response.status, response.headerFields);
+
+                // RFC 7230, 3.3.3. Message Body Length
+                // responses to HEAD requests and 204 and 304 responses never have a body
+                if (method == "HEAD" ||
+                    response.status.code == Status::NoContent ||
+                    response.status.code == Status::NotModified)
+                    state = State::complete;
+                // Content-Length must be ignored if Transfer-Encoding is received (RFC 7230, 3.2. Content-Length)
+                else if (chunkedResponse)
+                {
+                    contentLengthReceived = false;
+                    state = State::chunkSize;
+                }
+                else if (contentLengthReceived && contentLength == 0)
+                    state = State::complete;
+                else
+                    state = State::body;
+            }
+
+            // Parses the header fields in place and moves the header section to the header block.
+            // Names are lowercased where they are and obsolete folds are replaced with spaces by moving
+            // the rest of the value back, which never makes the value longer (RFC 7230, 3.2.4. Field Parsing).
+            void parseHeaderBlock()
+            {
+                auto& headerBlock = compactResponse->headerFields;
+                auto& block = headerBlock.block;
+                auto& fields = headerBlock.fields;
+
+                // the header section is moved without copying if the block has the same allocator
+                block = std::move(header);
+                header = ResponseString{getAllocator()};
+                fields.clear();
+                headerBlock.firstFields = {};
+                // the index + 1 of the last field with each ID, to link the next one to it
+                std::array<std::size_t, headerNames.size()> lastFields{};
+                // every header field takes at least one of the lines between the status line and the empty line
+                fields.reserve(static_cast<std::size_t>(std::count(block.cbegin(), block.cend(), '\n')) - 2);
+
+                auto statusLineResult = parseStatusLine(block.cbegin(), block.cend());
+
+                response.status = std::move(statusLineResult.second);
+                if (sink && sink->statusReceived) sink->statusReceived(response.status);
+
+                const auto data = &block[0];
+                const auto end = data + block.size();
+                const auto fieldsEnd = end - 2; // the empty line
+                auto i = data + (statusLineResult.first - block.cbegin());
+
+                while (i != fieldsEnd)
+                {
+                    // RFC 7230, 3.2. Header Fields
+                    const auto nameBegin = i;
+                    i = std::find_if(i, end, [](const char c) noexcept { return !isTokenChar(c); });
+                    if (i == nameBegin)
+                        throw ResponseError{"Invalid token"};
+
+                    std::transform(nameBegin, i, nameBegin, [](const char c) noexcept { return toLower(c); });
+                    const auto nameEnd = i;
+
+                    if (i == end || *i++ != ':')
+                        throw ResponseError{"Invalid header"};
+
+                    i = skipWhiteSpaces(i, end);
+
+                    const auto valueBegin = i;
+                    auto valueEnd = i;
+
+                    for (;;)
+                    {
+                        const auto segmentBegin = valueEnd;
+                        const auto segmentEnd = findFieldValueEnd(i, end);
+                        valueEnd = (valueEnd == i) ? segmentEnd : std::copy(i, segmentEnd, valueEnd);
+                        i = segmentEnd;
+
+                        // trim white spaces
+                        while (valueEnd != segmentBegin && isWhiteSpaceChar(*(valueEnd - 1))) --valueEnd;
+
+                        if (end - i < 3 || i[0] != '\r' || i[1] != '\n' || !isWhiteSpaceChar(i[2]))
+                            break;
+
+                        *valueEnd++ = ' ';
+                        i += 3;
+                    }
+
+                    if (i == end || *i++ != '\r')
+                        throw ResponseError{"Invalid header"};
+
+                    if (i == end || *i++ != '\n')
+                        throw ResponseError{"Invalid header"};
+
+                    const auto id = getHeaderId({nameBegin, static_cast<std::size_t>(nameEnd - nameBegin)});
+                    fields.push_back({static_cast<std::size_t>(nameBegin - data),
+                                      static_cast<std::size_t>(nameEnd - nameBegin),
+                                      static_cast<std::size_t>(valueBegin - data),
+                                      static_cast<std::size_t>(valueEnd - valueBegin),
+                                      id,
+                                      0});
+
+                    if (id != HeaderId::unknown)
+                    {
+                        auto& lastField = lastFields[static_cast<std::size_t>(id)];
+                        if (lastField != 0)
+                            fields[lastField - 1].next = fields.size();
+                        else
+                            headerBlock.firstFields[static_cast<std::size_t>(id)] = fields.size();
+                        lastField = fields.size();
+                    }
+
+                    processHeaderField(id, {valueBegin, static_cast<std::size_t>(valueEnd - valueBegin)});
+                }
+            }
+
+            // handles the header fields that determine the length of the body
+            void processHeaderField(const HeaderId id, const std::string_view value)
+            {
+                switch (id)
+                {
+                    case HeaderId::transferEncoding:
+                        // RFC 7230, 3.3.1. Transfer-Encoding
+                        if (value == "chunked")
+                            chunkedResponse = true;
+                        else
+                            throw ResponseError{"Unsupported transfer encoding: " + std::string{value}};
+                        break;
+                    case HeaderId::contentLength:
+                        // RFC 7230, 3.3.2. Content-Length
+                        contentLength = stringToUint<std::size_t>(value.cbegin(), value.cend());
+                        contentLengthReceived = true;
+                        if (!sink || !sink->dataReceived)
+                        {
+                            if (compactResponse)
+                                compactResponse->body.reserve(contentLength);
+                            else
+                                response.body.reserve(contentLength);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            static std::size_t parseChunkSize(const std::string_view chunkSizeLine)
+            {
+                if (chunkSizeLine.size() < 2 || chunkSizeLine[chunkSizeLine.size() - 2] != '\r')
+                    throw ResponseError{"Invalid chunk"};
+
+                // RFC 7230, 4.1.1. Chunk Extensions, the extensions are ignored
+                const auto sizeEnd = std::find(chunkSizeLine.cbegin(), chunkSizeLine.cend() - 2, ';');
+                if (sizeEnd == chunkSizeLine.cbegin())
+                    throw ResponseError{"Invalid chunk"};
+
+                return detail::hexStringToUint<std::size_t>(chunkSizeLine.cbegin(), sizeEnd);
+            }
+
+            // passes the data to the sink or appends it to the body
+            void writeBody(const std::uint8_t* data, const std::size_t size)
+            {
+                if (size == 0) return;
+
+                if (sink && sink->dataReceived)
+                    sink->dataReceived(data, size);
+                else if (compactResponse)
+                    compactResponse->body.insert(compactResponse->body.end(), data, data + size);
+                else
+                    response.body.insert(response.body.end(), data, data + size);
+
+                bodySize += size;
+            }
+
+            std::string method;
+            const ResponseSink* sink = nullptr;
+            CompactResponse* compactResponse = nullptr;
+            Response response;
+            State state = State::header;
+            ResponseString header; // the header section up to the current position
+            std::size_t lineBegin = 0U; // the beginning of the current line of the header section
+            ResponseString line; // the current line of the chunked body if it spans several pieces of data
+            std::size_t bodySize = 0U;
+            bool started = false;
+            bool contentLengthReceived = false;
+            std::size_t contentLength = 0U;
+            bool chunkedResponse = false;
+            std::size_t expectedChunkSize = 0U;
+        };
+
+        // RFC 7413, TCP Fast Open
+        // Connects with the beginning of the data in the SYN to the first address and returns the socket
+        // with the number of bytes already sent, falls back to a regular connection if Fast Open is not possible.
+        // The Fast Open attempt is the first one of the Happy Eyeballs attempts, so the next address is tried
+        // after connectionAttemptDelay and the data was sent only if the Fast Open attempt connects first.
+        // The data in the SYN may be delivered more than once (RFC 7413, 6.1. Performance Impact),
+        // so it must only be used for idempotent requests.
+        inline std::pair<Socket, std::size_t> connectFastOpen(const std::vector<Address>& addresses,
+                                                              const RequestMessage& request,
+                                                              const std::int64_t timeout,
+                                                              const SocketOptions& socketOptions)
+        {
+#if defined(MSG_FASTOPEN)
+            if (!addresses.empty())
+            {
+                const auto& address = addresses.front();
+                std::optional<std::size_t> sent;
+                std::vector<Socket> attempts;
+
+                try
+                {
+                    Socket socket{address.family, socketOptions};
+                    // only the head is sent in the SYN, which has room for little data anyway
+                    sent = socket.beginConnectFastOpen(reinterpret_cast<const sockaddr*>(&address.storage),
+                                                       address.size, request.head.data(), request.head.size());
+                    if (sent) attempts.push_back(std::move(socket));
+                }
+                catch (const std::system_error&)
+                {
+                    // try all the addresses the usual way
+                }
+
+                if (!attempts.empty())
+                {
+                    const auto fastOpenHandle = attempts.front().getHandle();
+                    auto socket = connect(addresses, 1, std::move(attempts), timeout, socketOptions);
+                    const auto sentSize = (socket.getHandle() == fastOpenHandle) ? *sent : 0;
+                    return {std::move(socket), sentSize};
+                }
+            }
+#else
+            static_cast<void>(request);
+#endif // defined(MSG_FASTOPEN)
+
+            return {connect(addresses, timeout, socketOptions), 0};
+        }
+
+        // updates the connection's persistence after a complete response (RFC 7230, 6.3. Persistence)
+        template <class HeaderFieldRange>
+        void updatePersistence(Connection& connection, const Status& status, const HeaderFieldRange& headerFields)
+        {
+            connection.persistent = isPersistentConnection(status, headerFields);
+
+            const auto keepAliveTimeout = getKeepAliveTimeout(headerFields);
+            connection.expiryTime = keepAliveTimeout ?
+                std::chrono::steady_clock::now() + *keepAliveTimeout :
+                std::chrono::steady_clock::time_point::max();
+        }
+
+        inline void updatePersistence(Connection& connection, const Response& response)
+        {
+            updatePersistence(connection, response.status, response.headerFields);
+        }
+
+        // writes all the data at the current position of the file
+        inline void writeFile(const int file, const std::uint8_t* data, std::size_t size)
+        {
+            while (size > 0)
+            {
+#if defined(_WIN32)
+                const auto result = _write(file, data, static_cast<unsigned int>((std::min)(size, std::size_t{0x7FFFFFFF})));
+#else
+                const auto result = ::write(file, data, size);
+                if (result == -1 && errno == EINTR) continue;
+#endif // defined(_WIN32)
+                if (result == -1)
+                    throw std::system_error{errno, std::generic_category(), "Failed to write file"};
+
+                data += result;
+                size -= static_cast<std::size_t>(result);
+            }
+        }
+
+#if defined(__linux__)
+        // Moves up to size bytes from the socket to the file through a pipe with splice, so that the data
+        // doesn't pass through user space, returns the number of bytes moved, which is less than the size
+        // only if the peer has disconnected
+        inline std::size_t receiveToFile(Socket& socket,
+                                         const int file,
+                                         const std::size_t size,
+                                         const std::chrono::milliseconds timeout,
+                                         const std::chrono::steady_clock::time_point stopTime)
+        {
+            struct Pipe final
+            {
+                Pipe()
+                {
+                    if (::pipe2(descriptors.data(), O_CLOEXEC | O_NONBLOCK) == -1)
+                        throw std::system_error{errno, std::system_category(), "Failed to create pipe"};
+                }
+
+                ~Pipe()
+                {
+                    ::close(descriptors[0]);
+                    ::close(descriptors[1]);
+                }
+
+                Pipe(const Pipe&) = delete;
+                Pipe& operator=(const Pipe&) = delete;
+
+                std::array<int, 2> descriptors;
+            } pipe;
+
+            // files that don't support splice (e.g. opened with O_APPEND) are written from a buffer
+            bool spliceToFile = true;
+            std::array<std::uint8_t, 16384> buffer;
+
+            std::size_t moved = 0;
+            while (moved < size)
+            {
+                auto received = socket.splice(pipe.descriptors[1], size - moved,
+                                              (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
+                if (received == 0) break; // disconnected
+
+                while (received > 0)
+                {
+                    ssize_t result = -1;
+                    if (spliceToFile)
+                    {
+                        result = ::splice(pipe.descriptors[0], nullptr, file, nullptr, received, SPLICE_F_MOVE);
+                        if (result == -1 && errno == EINVAL)
+                        {
+                            spliceToFile = false;
+                            continue;
+                        }
+                    }
+                    else
+                    {
+                        result = ::read(pipe.descriptors[0], buffer.data(), (std::min)(received, buffer.size()));
+                        if (result > 0) writeFile(file, buffer.data(), static_cast<std::size_t>(result));
+                    }
+
+                    if (result == -1)
+                    {
+                        if (errno == EINTR) continue;
+                        throw std::system_error{errno, std::system_category(), "Failed to write file"};
+                    }
+
+                    received -= static_cast<std::size_t>(result);
+                    moved += static_cast<std::size_t>(result);
+                }
+            }
+
+            return moved;
+        }
+#endif // defined(__linux__)
+
+        constexpr std::size_t minReceiveSize = 4096;
+        constexpr std::size_t maxReceiveSize = 4 * 1024 * 1024;
+
+        // A buffer for reading a response, which starts small for short responses and doubles every time
+        // a read fills it, so that large responses are read with few system calls.
+        // The memory is only allocated when the data is needed, and it is neither zero-filled nor copied
+        // when the buffer grows, because its data has been used by then.
+        class ReceiveBuffer final
+        {
+        public:
+            std::uint8_t* data()
+            {
+                if (allocatedSize != bufferSize)
+                {
+                    buffer.reset(new std::uint8_t[bufferSize]);
+                    allocatedSize = bufferSize;
+                }
+
+                return buffer.get();
+            }
+
+            std::size_t size() const noexcept { return bufferSize; }
+
+            // grows the buffer if a read of the given size has filled it
+            void update(const std::size_t received) noexcept
+            {
+                if (received == bufferSize && bufferSize < maxReceiveSize)
+                    bufferSize *= 2;
+            }
+
+        private:
+            std::size_t bufferSize = minReceiveSize;
+            std::size_t allocatedSize = 0;
+            std::unique_ptr<std::uint8_t[]> buffer;
+        };
+
+        // Receives up to size bytes straight into the end of the body, without the parser and the receive buffer,
+        // and returns their number, which is less than the size only if the peer has disconnected.
+        // The reads are as big as the receive buffer and grow it the same way, but its memory is not used.
+        template <class Body>
+        std::size_t receiveBody(Socket& socket,
+                                Body& body,
+                                const std::size_t size,
+                                ReceiveBuffer& buffer,
+                                const std::chrono::milliseconds timeout,
+                                const std::chrono::steady_clock::time_point stopTime)
+        {
+            std::size_t received = 0;
+            while (received < size)
+            {
+                // the body only grows by the part that is being read, which is still in the cache
+                // when the data is written over its zeros
+                const auto offset = body.size();
+                const auto readSize = (std::min)(size - received, buffer.size());
+                body.resize(offset + readSize);
+
+                const auto result = socket.recv(body.data() + offset, readSize,
+                                                (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
+                body.resize(offset + result);
+                if (result == 0) break; // disconnected
+
+                received += result;
+                buffer.update(result);
+            }
+
+            return received;
+        }
+
+        // sends all the buffers, the buffers are modified to track partial writes
+        inline void sendBuffers(Socket& socket,
+                                ConstBuffer* buffers,
+                                std::size_t count,
+                                const std::chrono::milliseconds timeout,
+                                const std::chrono::steady_clock::time_point stopTime)
+        {
+            for (;;)
+            {
+                while (count > 0 && buffers->size == 0)
+                {
+                    ++buffers;
+                    --count;
+                }
+
+                if (count == 0) return;
+
+                auto size = socket.send(buffers, count, (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
+
+                for (; count > 0 && size >= buffers->size; ++buffers, --count)
+                    size -= buffers->size;
+
+                if (count > 0)
+                {
+                    buffers->data = static_cast<const std::uint8_t*>(buffers->data) + size;
+                    buffers->size -= size;
+                }
+            }
+        }
+
+        // RFC 7230, 4.1. Chunked Transfer Coding
+        inline void sendChunks(Socket& socket,
+                               const std::function<std::size_t(std::uint8_t*, std::size_t)>& producer,
+                               const std::chrono::milliseconds timeout,
+                               const std::chrono::steady_clock::time_point stopTime)
+        {
+            static constexpr char digits[] = "0123456789ABCDEF";
+            static constexpr char lineEnd[] = "\r\n";
+
+            // the chunks are produced into one buffer, so the memory use doesn't depend on the size of the body
+            std::vector<std::uint8_t> chunk(16384);
+
+            for (;;)
+            {
+                const auto size = producer(chunk.data(), chunk.size());
+                if (size > chunk.size())
+                    throw RequestError{"Chunk is bigger than the buffer"};
+
+                // chunk-size in hexadecimal followed by CRLF
+                std::array<char, sizeof(std::size_t) * 2 + 2> sizeLine;
+                auto sizeLineBegin = sizeLine.end() - 2;
+                auto value = size;
+                do
+                {
+                    *--sizeLineBegin = digits[value & 0x0F];
+                    value >>= 4;
+                } while (value != 0);
+                sizeLine[sizeLine.size() - 2] = '\r';
+                sizeLine[sizeLine.size() - 1] = '\n';
+
+                // the last chunk has no data and is followed by an empty trailer section
+                std::array<ConstBuffer, 3> buffers{
+                    ConstBuffer{sizeLineBegin, static_cast<std::size_t>(sizeLine.end() - sizeLineBegin)},
+                    ConstBuffer{chunk.data(), size},
+                    ConstBuffer{lineEnd, 2}
+                };
+                sendBuffers(socket, buffers.data(), buffers.size(), timeout, stopTime);
+
+                if (size == 0) return;
+            }
+        }
+
+        // Sends the request over the connection and reads the response,
+        // returns nullopt if the connection was closed before any response data arrived
+        // and throws if it was closed in the middle of a response whose body goes to the file
+        inline std::optional<Response> exchange(Connection& connection,
+                                                const std::string& method,
+                                                const RequestMessage& request,
+                                                const std::chrono::milliseconds timeout,
+                                                const std::chrono::steady_clock::time_point stopTime,
+                                                std::size_t sentSize = 0,
+                                                const ResponseSink* responseSink = nullptr,
+                                                const int bodyFile = -1,
+                                                CompactResponse* compactResponse = nullptr)
+        {
+            auto& socket = connection.socket;
+            connection.persistent = false;
+
+            // send the request, partial writes can end anywhere in the head or the body
+            std::array<ConstBuffer, 2> buffers;
+            while (sentSize < request.size())
+            {
+                const auto remainingMilliseconds = (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1;
+
+                if (const auto count = request.getBuffers(sentSize, buffers))
+                    sentSize += socket.send(buffers.data(), count, remainingMilliseconds);
+                else // the rest of the body is in the file
+                    sentSize += socket.sendFile(request.file,
+                                                request.fileOffset + (sentSize - request.head.size()),
+                                                request.size() - sentSize,
+                                                remainingMilliseconds);
+            }
+
+            if (request.chunkedBody)
+                sendChunks(socket, request.chunkedBody->producer, timeout, stopTime);
+
+            // the receive buffer is not taken from the response allocator, because a monotonic resource
+            // would keep every size it has grown through until the response is released
+            ResponseParser parser{method, responseSink, compactResponse};
+            ReceiveBuffer receiveBuffer;
+            const auto collectingBody = !responseSink || !responseSink->dataReceived;
+
+            // read the response
+            for (;;)
+            {
+                const auto size = socket.recv(receiveBuffer.data(), receiveBuffer.size(),
+                                              (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
+                if (size == 0) // disconnected
+                {
+                    if (!parser.hasStarted()) return std::nullopt;
+
+                    // a file that ends early can't be told apart from a complete one later
+                    if (bodyFile != -1 && !parser.isComplete() && !parser.isEndedByClose())
+                        throw ResponseError{"Connection closed before the end of the response"};
+
+                    return std::move(parser.getResponse());
+                }
+
+                const auto consumed = parser.parse(receiveBuffer.data(), size);
+                receiveBuffer.update(size);
+
+                // the rest of a body with a known length is received straight into the body,
+                // which the parser has reserved for the whole content
+                if (collectingBody && bodyFile == -1)
+                    if (const auto remaining = parser.getRemainingContentLength())
+                    {
+                        parser.skipBody(compactResponse ?
+                                        receiveBody(socket, compactResponse->body, *remaining, receiveBuffer, timeout, stopTime) :
+                                        receiveBody(socket, parser.getResponse().body, *remaining, receiveBuffer, timeout, stopTime));
+                        if (!parser.isComplete()) // disconnected
+                            return std::move(parser.getResponse());
+                    }
+
+#if defined(__linux__)
+                // the rest of a successful response's body with a known length is moved to the file without copying
+                if (bodyFile != -1 && isSuccessfulStatus(parser.getResponse().status))
+                    if (const auto remaining = parser.getRemainingContentLength())
+                    {
+                        parser.skipBody(receiveToFile(socket, bodyFile, *remaining, timeout, stopTime));
+                        if (!parser.isComplete()) // disconnected
+                            throw ResponseError{"Connection closed before the end of the response"};
+                    }
+#else
+                static_cast<void>(bodyFile);
+#endif // defined(__linux__)
+
+                if (parser.isComplete())
+                {
+                    // the connection can't be reused if the server sent something after the response
+                    if (compactResponse)
+                        updatePersistence(connection, parser.getResponse().status, compactResponse->headerFields);
+                    else
+                        updatePersistence(connection, parser.getResponse());
+                    if (consumed != size) connection.persistent = false;
+
+                    return std::move(parser.getResponse());
+                }
+            }
+        }
+
+        // Writes up to depth requests ahead of their responses (RFC 7230, 6.3.2. Pipelining) and reads the responses in order,
+        // appends the responses to the given vector and stops early if the connection is closed or can't be reused
+        inline void exchangePipelined(Connection& connection,
+                                      const std::string& method,
+                                      const std::vector<std::vector<std::uint8_t>>& requests,
+                                      const std::size_t depth,
+                                      const std::chrono::milliseconds timeout,
+                                      const std::chrono::steady_clock::time_point stopTime,
+                                      std::vector<Response>& responses)
+        {
+            auto& socket = connection.socket;
+            connection.persistent = false;
+
+            auto sent = responses.size();
+            std::array<std::uint8_t, 4096> tempBuffer;
+            std::size_t offset = 0;
+            std::size_t size = 0;
+
+            while (responses.size() < requests.size())
+            {
+                // keep the pipeline filled
+                for (; sent < requests.size() && sent - responses.size() < (std::max)(depth, std::size_t{1}); ++sent)
+                {
+                    auto remaining = requests[sent].size();
+                    auto sendData = requests[sent].data();
+
+                    while (remaining > 0)
+                    {
+                        const auto sentSize = socket.send(sendData, remaining,
+                                                          (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
+                        remaining -= sentSize;
+                        sendData += sentSize;
+                    }
+                }
+
+                // the data after the end of a response belongs to the next one
+                ResponseParser parser{method};
+                while (!parser.isComplete())
+                {
+                    if (offset == size)
+                    {
+                        offset = 0;
+                        size = socket.recv(tempBuffer.data(), tempBuffer.size(),
+                                           (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1);
+                        if (size == 0) // disconnected
+                        {
+                            // a response delimited by the end of the connection is the last one,
+                            // a response cut short is left unanswered, so that its request is sent again
+                            if (parser.isEndedByClose())
+                                responses.push_back(std::move(parser.getResponse()));
+                            return;
+                        }
+                    }
+
+                    offset += parser.parse(tempBuffer.data() + offset, size - offset);
+                }
+
+                updatePersistence(connection, parser.getResponse());
+                responses.push_back(std::move(parser.getResponse()));
+                if (!connection.persistent) return;
+            }
+
+            // the connection can't be reused if the server sent something after the last response
+            if (offset != size) connection.persistent = false;
+        }
+
+        class ConnectionPool final
+        {
+        public:
+            ConnectionPool(const std::size_t maxIdle, const std::chrono::milliseconds timeout) noexcept:
+                maxIdleConnections{maxIdle}, idleTimeout{timeout}
+            {
+            }
+
+            // returns the most recently used idle connection to the origin that is still usable
+            std::optional<Connection> acquire(const std::string& origin)
+            {
+                auto& shard = getShard(origin);
+
+                for (;;)
+                {
+                    std::optional<Connection> connection;
+                    {
+                        std::lock_guard<std::mutex> lock{shard.mutex};
+                        const auto i = shard.idleConnections.find(origin);
+                        if (i == shard.idleConnections.end() || i->second.empty())
+                            return std::nullopt;
+
+                        connection.emplace(std::move(i->second.back()));
+                        i->second.pop_back();
+                    }
+
+                    // check the connection outside of the lock, a dead one is just dropped
+                    if (connection->isReusable())
+                        return connection;
+                }
+            }
+
+            void release(const std::string& origin, Connection connection)
+            {
+                if (!connection.persistent || maxIdleConnections == 0) return;
+
+                const auto now = std::chrono::steady_clock::now();
+                if (idleTimeout.count() >= 0)
+                    connection.expiryTime = (std::min)(connection.expiryTime, now + idleTimeout);
+
+                auto& shard = getShard(origin);
+                std::vector<Connection> evictedConnections;
+                {
+                    std::lock_guard<std::mutex> lock{shard.mutex};
+                    auto& connections = shard.idleConnections[origin];
+
+                    // evict the expired connections and the least recently used ones over the limit
+                    auto i = connections.begin();
+                    while (i != connections.end() &&
+                           (i->expiryTime <= now || static_cast<std::size_t>(connections.end() - i) >= maxIdleConnections))
+                        ++i;
+
+                    std::move(connections.begin(), i, std::back_inserter(evictedConnections));
+                    connections.erase(connections.begin(), i);
+                    connections.push_back(std::move(connection));
+                }
+                // evicted sockets are closed here, outside of the lock
+            }
+
+            void clear()
+            {
+                for (auto& shard : shards)
+                {
+                    std::unordered_map<std::string, std::vector<Connection>> idleConnections;
+                    {
+                        std::lock_guard<std::mutex> lock{shard.mutex};
+                        std::swap(idleConnections, shard.idleConnections);
+                    }
+                }
+            }
+
+        private:
+            // origins are spread over independently locked shards to reduce contention between threads
+            struct Shard final
+            {
+                std::mutex mutex;
+                std::unordered_map<std::string, std::vector<Connection>> idleConnections;
+            };
+
+            Shard& getShard(const std::string& origin) noexcept
+            {
+                return shards[std::hash<std::string>{}(origin) % shards.size()];
+            }
+
+            std::size_t maxIdleConnections;
+            std::chrono::milliseconds idleTimeout;
+            std::array<Shard, 16> shards;
+        };
+
+#if defined(__linux__) && defined(IORING_ENTER_EXT_ARG)
+        // A minimal io_uring instance driven with raw system calls,
+        // submissions are queued in the ring and handed to the kernel in batches by submitAndWait
+        class IoUring final
+        {
+        public:
+            struct Completion final
+            {
+                std::uint64_t userData;
+                std::int32_t result;
+            };
+
+            IoUring(const unsigned entries, const std::size_t bufferCount, const std::size_t bufferSize)
+            {
+                io_uring_params parameters{};
+                descriptor = static_cast<int>(syscall(__NR_io_uring_setup, entries, &parameters));
+                if (descriptor == -1)
+                    throw std::system_error{errno, std::system_category(), "Failed to set up io_uring"};
+
+                try
+                {
+                    // waiting with a timeout requires the extended arguments of io_uring_enter (Linux 5.11)
+                    if (!(parameters.features & IORING_FEAT_EXT_ARG))
+                        throw std::system_error{ENOSYS, std::system_category(), "io_uring_enter extended arguments are not supported"};
+
+                    submissionRingSize = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+                    completionRingSize = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+                    if (parameters.features & IORING_FEAT_SINGLE_MMAP)
+                        submissionRingSize = completionRingSize = (std::max)(submissionRingSize, completionRingSize);
+
+                    submissionRing = map(submissionRingSize, IORING_OFF_SQ_RING);
+                    completionRing = (parameters.features & IORING_FEAT_SINGLE_MMAP) ?
+                        submissionRing : map(completionRingSize, IORING_OFF_CQ_RING);
+                    submissionEntriesSize = parameters.sq_entries * sizeof(io_uring_sqe);
+                    submissionEntries = static_cast<io_uring_sqe*>(map(submissionEntriesSize, IORING_OFF_SQES));
+                }
+                catch (...)
+                {
+                    unmap();
+                    ::close(descriptor);
+                    throw;
+                }
+
+                auto submission = static_cast<std::uint8_t*>(submissionRing);
+                submissionHead = reinterpret_cast<unsigned*>(submission + parameters.sq_off.head);
+                submissionTail = reinterpret_cast<unsigned*>(submission + parameters.sq_off.tail);
+                submissionMask = *reinterpret_cast<unsigned*>(submission + parameters.sq_off.ring_mask);
+                submissionArray = reinterpret_cast<unsigned*>(submission + parameters.sq_off.array);
+                submissionEntryCount = parameters.sq_entries;
+                queueTail = *submissionTail;
+
+                auto completion = static_cast<std::uint8_t*>(completionRing);
+                completionHead = reinterpret_cast<unsigned*>(completion + parameters.cq_off.head);
+                completionTail = reinterpret_cast<unsigned*>(completion + parameters.cq_off.tail);
+                completionMask = *reinterpret_cast<unsigned*>(completion + parameters.cq_off.ring_mask);
+                completionEntries = reinterpret_cast<io_uring_cqe*>(completion + parameters.cq_off.cqes);
+
+                // registered buffers are pinned once instead of on every read,
+                // running without them is fine (e.g. when the locked memory limit is too low)
+                buffers.resize(bufferCount * bufferSize);
+                std::vector<iovec> vectors(bufferCount);
+                for (std::size_t i = 0; i < bufferCount; ++i)
+                    vectors[i] = iovec{buffers.data() + i * bufferSize, bufferSize};
+
+                if (bufferCount > 0 &&
+                    syscall(__NR_io_uring_register, descriptor, IORING_REGISTER_BUFFERS,
+                            vectors.data(), static_cast<unsigned>(vectors.size())) == 0)
+                {
+                    registeredBufferSize = bufferSize;
+                    for (std::size_t i = bufferCount; i > 0; --i)
+                        freeBuffers.push_back(static_cast<std::uint16_t>(i - 1));
+                }
+                else
+                    buffers.clear();
+            }
+
+            ~IoUring()
+            {
+                unmap();
+                ::close(descriptor);
+            }
+
+            IoUring(const IoUring&) = delete;
+            IoUring& operator=(const IoUring&) = delete;
+
+            // returns a cleared submission queue entry, which is handed to the kernel by the next submitAndWait
+            io_uring_sqe& getSubmission()
+            {
+                if (getQueuedCount() == submissionEntryCount)
+                {
+                    enter(0, 0, -1);
+                    if (getQueuedCount() == submissionEntryCount)
+                        throw std::system_error{EBUSY, std::system_category(), "io_uring submission queue is full"};
+                }
+
+                const auto index = queueTail++ & submissionMask;
+                auto& entry = submissionEntries[index];
+                entry = io_uring_sqe{};
+                submissionArray[index] = index;
+                return entry;
+            }
+
+            // submits the queued entries and waits at most the given time (or indefinitely if negative) for a completion
+            void submitAndWait(const std::int64_t timeout)
+            {
+                enter(1, IORING_ENTER_GETEVENTS, timeout);
+            }
+
+            std::vector<Completion> reapCompletions()
+            {
+                std::vector<Completion> completions;
+
+                auto head = *completionHead;
+                const auto tail = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+                for (; head != tail; ++head)
+                {
+                    const auto& entry = completionEntries[head & completionMask];
+                    completions.push_back(Completion{entry.user_data, entry.res});
+                }
+                __atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+
+                return completions;
+            }
+
+            // returns the index of a free registered buffer if there is any
+            std::optional<std::uint16_t> acquireBuffer()
+            {
+                if (freeBuffers.empty()) return std::nullopt;
+                const auto index = freeBuffers.back();
+                freeBuffers.pop_back();
+                return index;
+            }
+
+            void releaseBuffer(const std::uint16_t index)
+            {
+                freeBuffers.push_back(index);
+            }
+
+            std::uint8_t* getBuffer(const std::uint16_t index) noexcept
+            {
+                return buffers.data() + index * registeredBufferSize;
+            }
+
+            std::size_t getBufferSize() const noexcept
+            {
+                return registeredBufferSize;
+            }
+
+        private:
+            void* map(const std::size_t size, const off_t offset)
+            {
+                const auto result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, descriptor, offset);
+                if (result == MAP_FAILED)
+                    throw std::system_error{errno, std::system_category(), "Failed to map io_uring"};
+                return result;
+            }
+
+            void unmap() noexcept
+            {
+                if (submissionEntries) munmap(submissionEntries, submissionEntriesSize);
+                if (completionRing && completionRing != submissionRing) munmap(completionRing, completionRingSize);
+                if (submissionRing) munmap(submissionRing, submissionRingSize);
+            }
+
+            unsigned getQueuedCount() const noexcept
+            {
+                return queueTail - __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE);
+            }
+
+            void enter(const unsigned minComplete, const unsigned flags, const std::int64_t timeout)
+            {
+                __kernel_timespec timeSpec{timeout / 1000, (timeout % 1000) * 1000000};
+                io_uring_getevents_arg argument{};
+                if (timeout >= 0) argument.ts = reinterpret_cast<std::uint64_t>(&timeSpec);
+
+                // the entries are only published to the kernel here, after they have been filled in
+                __atomic_store_n(submissionTail, queueTail, __ATOMIC_RELEASE);
+
+                for (;;)
+                {
+                    const auto result = syscall(__NR_io_uring_enter, descriptor, getQueuedCount(), minComplete,
+                                                flags | IORING_ENTER_EXT_ARG, &argument, sizeof(argument));
+                    if (result >= 0) return;
+
+                    if (errno == ETIME) return;
+                    if (errno == EINTR) continue;
+                    // the completion queue is full, its entries have to be reaped before submitting more
+                    if (errno == EBUSY || errno == EAGAIN) return;
+
+                    throw std::system_error{errno, std::system_category(), "Failed to enter io_uring"};
+                }
+            }
+
+            int descriptor = -1;
+            void* submissionRing = nullptr;
+            std::size_t submissionRingSize = 0;
+            void* completionRing = nullptr;
+            std::size_t completionRingSize = 0;
+            io_uring_sqe* submissionEntries = nullptr;
+            std::size_t submissionEntriesSize = 0;
+            unsigned* submissionHead = nullptr;
+            unsigned* submissionTail = nullptr;
+            unsigned* submissionArray = nullptr;
+            unsigned submissionMask = 0;
+            unsigned submissionEntryCount = 0;
+            unsigned queueTail = 0;
+            unsigned* completionHead = nullptr;
+            unsigned* completionTail = nullptr;
+            io_uring_cqe* completionEntries = nullptr;
+            unsigned completionMask = 0;
+            std::vector<std::uint8_t> buffers;
+            std::size_t registeredBufferSize = 0;
+            std::vector<std::uint16_t> freeBuffers;
+        };
+#endif // defined(__linux__) && defined(IORING_ENTER_EXT_ARG)
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+        // Waits for socket readiness and deadlines on a background thread for the coroutine interface,
+        // the callbacks are called on that thread and are expected to hand the work over to an executor
+        class Reactor final
+        {
+        public:
+            using Callback = std::function<void(bool ready)>;
+
+            Reactor()
+            {
+                if (pipe(wakeUpPipe) == -1)
+                    throw std::system_error{errno, std::system_category(), "Failed to create pipe"};
+
+                for (const auto descriptor : wakeUpPipe)
+                {
+                    fcntl(descriptor, F_SETFL, fcntl(descriptor, F_GETFL, 0) | O_NONBLOCK);
+                    fcntl(descriptor, F_SETFD, FD_CLOEXEC);
+                }
+
+                thread = std::thread{&Reactor::run, this};
+            }
+
+            ~Reactor()
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    stopping = true;
+                }
+
+                wakeUp();
+                thread.join();
+                ::close(wakeUpPipe[0]);
+                ::close(wakeUpPipe[1]);
+            }
+
+            Reactor(const Reactor&) = delete;
+            Reactor& operator=(const Reactor&) = delete;
+
+            // calls the callback once the socket is ready for the events or with false when the deadline has passed,
+            // a negative handle just waits for the deadline
+            void wait(const int handle,
+                      const short events,
+                      const std::chrono::steady_clock::time_point deadline,
+                      Callback callback)
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    newWaits.push_back(Wait{handle, events, deadline, std::move(callback)});
+                }
+
+                wakeUp();
+            }
+
+        private:
+            struct Wait final
+            {
+                int handle;
+                short events;
+                std::chrono::steady_clock::time_point deadline;
+                Callback callback;
+            };
+
+            void wakeUp() noexcept
+            {
+                const char value = 0;
+                // a full pipe already wakes the thread up
+                while (write(wakeUpPipe[1], &value, sizeof(value)) == -1 && errno == EINTR);
+            }
+
+            void run()
+            {
+                std::vector<Wait> waits;
+                std::vector<pollfd> descriptors;
+
+                for (;;)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock{mutex};
+                        if (stopping) return;
+                        std::move(newWaits.begin(), newWaits.end(), std::back_inserter(waits));
+                        newWaits.clear();
+                    }
+
+                    descriptors.clear();
+                    descriptors.push_back(pollfd{wakeUpPipe[0], POLLIN, 0});
+                    std::int64_t timeout = -1;
+                    for (const auto& wait : waits)
+                    {
+                        descriptors.push_back(pollfd{wait.handle, wait.events, 0});
+                        if (wait.deadline != std::chrono::steady_clock::time_point::max())
+                        {
+                            const auto remainingTime = getRemainingMilliseconds(wait.deadline);
+                            timeout = (timeout >= 0) ? (std::min)(timeout, remainingTime) : remainingTime;
+                        }
+                    }
+
+                    // a lasting failure (e.g. ENOMEM, or more descriptors than RLIMIT_NOFILE allows) would fail
+                    // again right away, so all the waits end as not ready instead of being retried
+                    const auto pollFailed = ::poll(descriptors.data(), static_cast<nfds_t>(descriptors.size()),
+                                                   static_cast<int>((std::min)(timeout, std::int64_t{INT32_MAX}))) == -1 &&
+                        errno != EINTR;
+
+                    if (descriptors[0].revents)
+                    {
+                        char buffer[256];
+                        while (read(wakeUpPipe[0], buffer, sizeof(buffer)) > 0);
+                    }
+
+                    const auto now = std::chrono::steady_clock::now();
+                    std::vector<std::pair<Callback, bool>> callbacks;
+                    std::size_t remaining = 0;
+                    for (std::size_t i = 0; i < waits.size(); ++i)
+                    {
+                        const auto ready = !pollFailed && descriptors[i + 1].revents != 0;
+                        if (ready || pollFailed || waits[i].deadline <= now)
+                            callbacks.emplace_back(std::move(waits[i].callback), ready);
+                        else
+                            waits[remaining++] = std::move(waits[i]);
+                    }
+                    waits.resize(remaining);
+
+                    for (const auto& callback : callbacks)
+                        callback.first(callback.second);
+                }
+            }
+
+            std::mutex mutex;
+            std::vector<Wait> newWaits;
+            bool stopping = false;
+            int wakeUpPipe[2];
+            std::thread thread;
+        };
+
+        inline Reactor& getReactor()
+        {
+            static Reactor reactor;
+            return reactor;
+        }
+
+        using Executor = std::function<void(std::function<void()>)>;
+
+        // Suspends the coroutine until the socket is ready and resumes it through the executor
+        struct SocketAwaiter final
+        {
+            int handle;
+            short events;
+            std::chrono::steady_clock::time_point deadline;
+            const Executor& executor;
+            bool ready = false;
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(const std::coroutine_handle<> coroutine)
+            {
+                getReactor().wait(handle, events, deadline, [this, coroutine, resumeExecutor = executor](const bool isReady) {
+                    ready = isReady;
+                    resumeExecutor([coroutine]() { coroutine.resume(); });
+                });
+            }
+
+            void await_resume() const
+            {
+                if (!ready) throw ResponseError{"Request timed out"};
+            }
+        };
+
+        // Runs the lookup on the lookup pool and resumes the coroutine through the executor
+        // when it has finished or when the deadline has passed, whichever comes first
+        struct LookupAwaiter final
+        {
+            struct State final
+            {
+                std::atomic<bool> finished{false};
+                bool timedOut = false;
+                std::vector<Address> addresses;
+                std::exception_ptr error;
+            };
+
+            std::function<std::vector<Address>()> lookup;
+            std::chrono::steady_clock::time_point deadline;
+            const Executor& executor;
+            std::shared_ptr<State> state = std::make_shared<State>();
+
+            bool await_ready() const noexcept { return false; }
+
+            void await_suspend(const std::coroutine_handle<> coroutine)
+            {
+                // the coroutine may be resumed on another thread (and the awaiter destroyed) as soon as
+                // the deadline wait has been posted, so everything that is needed afterwards is copied first
+                const auto resume = [coroutine]() { coroutine.resume(); };
+                const auto lookupDeadline = deadline;
+                const auto lookupState = state;
+                const auto resumeExecutor = executor;
+                auto addressLookup = std::move(lookup);
+
+                if (lookupDeadline != std::chrono::steady_clock::time_point::max())
+                    getReactor().wait(-1, 0, lookupDeadline, [lookupState, resumeExecutor, resume](bool) {
+                        if (!lookupState->finished.exchange(true))
+                        {
+                            lookupState->timedOut = true;
+                            resumeExecutor(resume);
+                        }
+                    });
+
+                getLookupPool().post([lookupState, addressLookup = std::move(addressLookup), resumeExecutor, resume]() {
+                    try
+                    {
+                        lookupState->addresses = addressLookup();
+                    }
+                    catch (...)
+                    {
+                        lookupState->error = std::current_exception();
+                    }
+
+                    if (!lookupState->finished.exchange(true))
+                        resumeExecutor(resume);
+                }, lookupDeadline);
+            }
+
+            std::vector<Address> await_resume() const
+            {
+                if (state->timedOut) throw ResponseError{"Request timed out"};
+                if (state->error) std::rethrow_exception(state->error);
+                return std::move(state->addresses);
+            }
+        };
+#endif // defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+    }
+
+    struct ResolverOptions final
+    {
+        // how long resolved addresses are served from the cache
+        std::chrono::milliseconds timeToLive = std::chrono::seconds{60};
+        // how long expired addresses are still served while they are being refreshed in the background
+        std::chrono::milliseconds staleTimeToLive = std::chrono::seconds{60};
+        // how long failed resolutions are cached
+        std::chrono::milliseconds negativeTimeToLive = std::chrono::seconds{5};
+        // Replaces the system resolver (e.g. with a DNS client or a fixed table). Like the system resolver it is run
+        // on the lookup pool while the caller waits at most until the request's timeout, lookups without a timeout
+        // run on the resolving thread. Failures must be reported with std::system_error to be cached.
+        std::function<std::vector<Address>(const std::string& host,
+                                           const std::string& port,
+                                           InternetProtocol internetProtocol)> lookup;
+    };
+
+    // Thread-safe cache of resolved addresses that can be shared between requests and clients
+    class Resolver final
+    {
+    public:
+        explicit Resolver(const ResolverOptions& options = {}):
+            state{std::make_shared<State>(options)}
+        {
+        }
+
+        // Resolves the host to the given address without a lookup, like curl's --resolve host:port:address,
+        // can be called multiple times to add several addresses
+        void addOverride(const std::string& host, const std::string& port, const std::string& address)
+        {
+            const auto addresses = lookupAddresses(address, port, InternetProtocol::any, AI_NUMERICHOST);
+
+            std::lock_guard<std::mutex> lock{state->mutex};
+            auto& overrideAddresses = state->overrides[toLower(host) + ':' + port];
+            overrideAddresses.insert(overrideAddresses.end(), addresses.begin(), addresses.end());
+        }
+
+        // a negative timeout waits for the system resolver as long as it takes
+        std::vector<Address> resolve(const std::string& host,
+                                     const std::string& port,
+                                     const InternetProtocol internetProtocol,
+                                     const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto name = toLower(host) + ':' + port;
+            const auto key = name + ':' + std::to_string(static_cast<int>(internetProtocol));
+
+            {
+                std::lock_guard<std::mutex> lock{state->mutex};
+
+                const auto overrideIterator = state->overrides.find(name);
+                if (overrideIterator != state->overrides.end())
+                {
+                    std::vector<Address> result;
+                    for (const auto& address : overrideIterator->second)
+                        if (internetProtocol == InternetProtocol::any ||
+                            address.family == getAddressFamily(internetProtocol))
+                            result.push_back(address);
+
+                    if (result.empty())
+                        throw RequestError{"No override address of the requested protocol for " + host};
+
+                    return result;
+                }
+
+                const auto now = std::chrono::steady_clock::now();
+                const auto entryIterator = state->entries.find(key);
+                if (entryIterator != state->entries.end())
+                {
+                    auto& entry = entryIterator->second;
+                    if (now < entry.expiryTime)
+                    {
+                        if (entry.error) std::rethrow_exception(entry.error);
+                        return entry.addresses;
+                    }
+
+                    if (!entry.error && now < entry.expiryTime + state->options.staleTimeToLive)
+                    {
+                        if (!entry.refreshing && now >= entry.nextRefreshTime)
+                        {
+                            entry.refreshing = true;
+                            refresh(state, key, host, port, internetProtocol);
+                        }
+
+                        return entry.addresses;
+                    }
+                }
+            }
+
+            return lookup(*state, key, host, port, internetProtocol, timeout.count());
+        }
+
+        // resolves the host on the lookup pool, can be used to resolve many hosts in parallel
+        std::future<std::vector<Address>> resolveAsync(const std::string& host,
+                                                       const std::string& port,
+                                                       const InternetProtocol internetProtocol)
+        {
+            auto task = std::make_shared<std::packaged_task<std::vector<Address>()>>(
+                [resolverState = state, host, port, internetProtocol]() {
+                    Resolver resolver{resolverState};
+                    return resolver.resolve(host, port, internetProtocol);
+                });
+            auto result = task->get_future();
+            getLookupPool().post([task]() { (*task)(); });
+            return result;
+        }
+
+        // removes all cached addresses (overrides are kept)
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock{state->mutex};
+            state->entries.clear();
+        }
+
+    private:
+        struct Entry final
+        {
+            std::vector<Address> addresses;
+            std::exception_ptr error;
+            std::chrono::steady_clock::time_point expiryTime;
+            // a failed refresh is not retried before this time
+            std::chrono::steady_clock::time_point nextRefreshTime;
+            bool refreshing = false;
+        };
+
+        // shared with the background refreshes, so that the resolver can be destroyed while they are running
+        struct State final
+        {
+            explicit State(const ResolverOptions& resolverOptions):
+                options{resolverOptions}
+            {
+            }
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+            winsock::Api winSock;
+#endif // defined(_WIN32) || defined(__CYGWIN__)
+            const ResolverOptions options;
+            std::mutex mutex;
+            std::unordered_map<std::string, Entry> entries;
+            std::unordered_map<std::string, std::vector<Address>> overrides;
+        };
+
+        static std::vector<Address> lookup(State& cache,
+                                           const std::string& key,
+                                           const std::string& host,
+                                           const std::string& port,
+                                           const InternetProtocol internetProtocol,
+                                           const std::int64_t timeout)
+        {
+            try
+            {
+                // a timed out lookup is not cached
+                auto addresses = cache.options.lookup ?
+                    lookupWithTimeout([addressLookup = cache.options.lookup, host, port, internetProtocol]() {
+                        return addressLookup(host, port, internetProtocol);
+                    }, timeout) :
+                    detail::resolve(host, port, internetProtocol, timeout);
+
+                std::lock_guard<std::mutex> lock{cache.mutex};
+                auto& entry = cache.entries[key];
+                entry.addresses = addresses;
+                entry.error = nullptr;
+                entry.expiryTime = std::chrono::steady_clock::now() + cache.options.timeToLive;
+                entry.refreshing = false;
+
+                return addresses;
+            }
+            catch (const std::system_error&)
+            {
+                std::lock_guard<std::mutex> lock{cache.mutex};
+                auto& entry = cache.entries[key];
+
+                // keep serving the stale addresses if only the refresh has failed,
+                // but don't retry it for the negative time to live, so that a failing DNS is not flooded
+                if (entry.refreshing)
+                {
+                    entry.refreshing = false;
+                    entry.nextRefreshTime = std::chrono::steady_clock::now() + cache.options.negativeTimeToLive;
+                }
+                else
+                {
+                    entry.addresses.clear();
+                    entry.error = std::current_exception();
+                    entry.expiryTime = std::chrono::steady_clock::now() + cache.options.negativeTimeToLive;
+                }
+
+                throw;
+            }
+        }
+
+        static void refresh(const std::shared_ptr<State>& cache,
+                            const std::string& key,
+                            const std::string& host,
+                            const std::string& port,
+                            const InternetProtocol internetProtocol)
+        {
+            getLookupPool().post([cache, key, host, port, internetProtocol]() {
+                try
+                {
+                    lookup(*cache, key, host, port, internetProtocol, -1);
+                }
+                catch (const std::exception&)
+                {
+                }
+            });
+        }
+
+        explicit Resolver(std::shared_ptr<State> resolverState) noexcept:
+            state{std::move(resolverState)}
+        {
+        }
+
+        std::shared_ptr<State> state;
+    };
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+    // Result of a coroutine, which starts when it is awaited and resumes the awaiting coroutine when it has finished
+    template <class T>
+    class Task final
+    {
+    public:
+        struct promise_type final
+        {
+            Task get_return_object() noexcept
+            {
+                return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+
+            auto final_suspend() const noexcept
+            {
+                struct FinalAwaiter final
+                {
+                    bool await_ready() const noexcept { return false; }
+
+                    std::coroutine_handle<> await_suspend(const std::coroutine_handle<promise_type> coroutine) const noexcept
+                    {
+                        const auto continuation = coroutine.promise().continuation;
+                        return continuation ? continuation : std::noop_coroutine();
+                    }
+
+                    void await_resume() const noexcept {}
+                };
+
+                return FinalAwaiter{};
+            }
+
+            template <class Value>
+            void return_value(Value&& value)
+            {
+                result.emplace(std::forward<Value>(value));
+            }
+
+            void unhandled_exception() noexcept
+            {
+                error = std::current_exception();
+            }
+
+            std::coroutine_handle<> continuation;
+            std::optional<T> result;
+            std::exception_ptr error;
+        };
+
+        Task(Task&& other) noexcept:
+            coroutine{std::exchange(other.coroutine, nullptr)}
+        {
+        }
+
+        Task& operator=(Task&& other) noexcept
+        {
+            if (&other == this) return *this;
+            if (coroutine) coroutine.destroy();
+            coroutine = std::exchange(other.coroutine, nullptr);
+            return *this;
+        }
+
+        ~Task()
+        {
+            if (coroutine) coroutine.destroy();
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(const std::coroutine_handle<> awaitingCoroutine) noexcept
+        {
+            coroutine.promise().continuation = awaitingCoroutine;
+            return coroutine;
+        }
+
+        T await_resume()
+        {
+            auto& promise = coroutine.promise();
+            if (promise.error) std::rethrow_exception(promise.error);
+            return std::move(*promise.result);
+        }
+
+    private:
+        explicit Task(const std::coroutine_handle<promise_type> handle) noexcept:
+            coroutine{handle}
+        {
+        }
+
+        std::coroutine_handle<promise_type> coroutine;
+    };
+#endif // defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+
+    enum class SaturationPolicy: std::uint8_t
+    {
+        block, // wait until there is room in the queue
+        reject // throw a ResponseError
+    };
+
+    struct WorkerPoolOptions final
+    {
+        // the number of worker threads, zero uses the number of hardware threads
+        std::size_t threadCount = 0;
+        // the maximum number of jobs waiting for a worker
+        std::size_t queueDepth = 1024;
+        // what happens to new jobs while the queue is full
+        SaturationPolicy saturationPolicy = SaturationPolicy::block;
+    };
+
+    // Bounded thread pool, each worker has its own queue and takes jobs from the other queues when its own is empty,
+    // so that a few slow jobs don't hold up the jobs queued behind them
+    class WorkerPool final
+    {
+    public:
+        explicit WorkerPool(const WorkerPoolOptions& options = {}):
+            queueDepth{(std::max)(options.queueDepth, std::size_t{1})},
+            saturationPolicy{options.saturationPolicy}
+        {
+            auto threadCount = options.threadCount;
+            if (threadCount == 0) threadCount = (std::max)(std::thread::hardware_concurrency(), 1U);
+
+            for (std::size_t i = 0; i < threadCount; ++i)
+                queues.push_back(std::make_unique<Queue>());
+
+            try
+            {
+                for (std::size_t i = 0; i < threadCount; ++i)
+                    workers.emplace_back(&WorkerPool::work, this, i);
+            }
+            catch (...)
+            {
+                stop();
+                throw;
+            }
+        }
+
+        // the queued jobs are finished before the workers exit
+        ~WorkerPool()
+        {
+            stop();
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // jobs posted from a worker of the pool go to its own queue and are never blocked or rejected,
+        // because a saturated pool could otherwise wait for itself
+        void post(std::function<void()> job)
+        {
+            const auto worker = getCurrentWorker();
+            const auto queueIndex = (worker.first == this) ? worker.second : nextQueue++ % queues.size();
+
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                if (worker.first != this && queuedCount >= queueDepth)
+                {
+                    if (saturationPolicy == SaturationPolicy::reject)
+                        throw ResponseError{"Worker pool queue is full"};
+
+                    spaceAvailable.wait(lock, [this]() noexcept { return queuedCount < queueDepth; });
+                }
+
+                ++queuedCount;
+            }
+
+            {
+                auto& queue = *queues[queueIndex];
+                std::lock_guard<std::mutex> lock{queue.mutex};
+                queue.jobs.push_back(std::move(job));
+            }
+
+            workAvailable.notify_one();
+        }
+
+        template <class Function>
+        std::future<std::invoke_result_t<Function>> submit(Function function)
+        {
+            auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Function>()>>(std::move(function));
+            auto result = task->get_future();
+            post([task]() { (*task)(); });
+            return result;
+        }
+
+        std::size_t getThreadCount() const noexcept
+        {
+            return workers.size();
+        }
+
+    private:
+        struct Queue final
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> jobs;
+        };
+
+        static std::pair<const WorkerPool*, std::size_t>& getCurrentWorker() noexcept
+        {
+            static thread_local std::pair<const WorkerPool*, std::size_t> currentWorker{nullptr, 0};
+            return currentWorker;
+        }
+
+        // takes the oldest job of the own queue or the newest job of another queue
+        bool take(const std::size_t index, std::function<void()>& job)
+        {
+            for (std::size_t i = 0; i < queues.size(); ++i)
+            {
+                auto& queue = *queues[(index + i) % queues.size()];
+                std::lock_guard<std::mutex> lock{queue.mutex};
+                if (queue.jobs.empty()) continue;
+
+                if (i == 0)
+                {
+                    job = std::move(queue.jobs.front());
+                    queue.jobs.pop_front();
+                }
+                else
+                {
+                    job = std::move(queue.jobs.back());
+                    queue.jobs.pop_back();
+                }
+
+                return true;
+            }
+
+            return false;
+        }
+
+        void work(const std::size_t index)
+        {
+            getCurrentWorker() = {this, index};
+
+            for (;;)
+            {
+                std::function<void()> job;
+                if (take(index, job))
+                {
+                    {
+                        std::lock_guard<std::mutex> lock{mutex};
+                        --queuedCount;
+                    }
+
+                    spaceAvailable.notify_one();
+                    job();
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock{mutex};
+                // the count is increased before the job is queued, so it might not be visible yet
+                if (queuedCount > 0)
+                {
+                    lock.unlock();
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                if (stopping) return;
+                workAvailable.wait(lock, [this]() noexcept { return stopping || queuedCount > 0; });
+            }
+        }
+
+        void stop() noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                stopping = true;
+            }
+
+            workAvailable.notify_all();
+            for (auto& worker : workers)
+                worker.join();
+        }
+
+        std::size_t queueDepth;
+        SaturationPolicy saturationPolicy;
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::atomic<std::size_t> nextQueue{0};
+        std::mutex mutex;
+        std::condition_variable workAvailable;
+        std::condition_variable spaceAvailable;
+        std::size_t queuedCount = 0;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+    };
+
+    // the worker pool used by Request::sendAsync unless another one is given
+    inline WorkerPool& getWorkerPool()
+    {
+        static WorkerPool workerPool;
+        return workerPool;
+    }
+
+    class Request final
+    {
+    public:
+        explicit Request(const std::string& uriString,
+                         const InternetProtocol protocol = InternetProtocol::v4,
+                         std::shared_ptr<Resolver> addressResolver = nullptr,
+                         const SocketOptions& options = {}):
+            internetProtocol{protocol},
+            uri{parseUri(uriString.begin(), uriString.end())},
+            resolver{std::move(addressResolver)},
+            socketOptions{options}
+        {
+        }
+
+        Response send(const std::string& method = "GET",
+                      const std::string& body = "",
+                      const HeaderFields& headerFields = {},
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(method, encodeRequest(uri, method, body, headerFields), timeout, stopTime);
+        }
+
+        Response send(const std::string& method,
+                      const std::vector<uint8_t>& body,
+                      const HeaderFields& headerFields = {},
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(method, encodeRequest(uri, method, body, headerFields), timeout, stopTime);
+        }
+
+        Response send(const std::string& method,
+                      const std::string& body,
+                      const HeaderFields& headerFields,
+                      const ResponseSink& sink,
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(method, encodeRequest(uri, method, body, headerFields), timeout, stopTime, &sink);
+        }
+
+        // Passes the response to the sink while it is being received instead of collecting the body in memory,
+        // the returned response has the status and the header fields, but no body
+        Response send(const std::string& method,
+                      const std::vector<uint8_t>& body,
+                      const HeaderFields& headerFields,
+                      const ResponseSink& sink,
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(method, encodeRequest(uri, method, body, headerFields), timeout, stopTime, &sink);
+        }
+
+        CompactResponse sendCompact(const std::string& method = "GET",
+                                    const std::string& body = "",
+                                    const HeaderFields& headerFields = {},
+                                    const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1},
+                                    const ResponseAllocator& allocator = {})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            CompactResponse result{allocator};
+            auto response = send(method, encodeRequest(uri, method, body, headerFields), timeout, stopTime,
+                                 nullptr, -1, &result);
+            result.status = std::move(response.status);
+            return result;
+        }
+
+        // Like send, but keeps the response header fields in one block instead of a string pair each.
+        // The header section and the body are allocated with the allocator,
+        // e.g. from a std::pmr::monotonic_buffer_resource that is released after the response has been used.
+        CompactResponse sendCompact(const std::string& method,
+                                    const std::vector<uint8_t>& body,
+                                    const HeaderFields& headerFields = {},
+                                    const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1},
+                                    const ResponseAllocator& allocator = {})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            CompactResponse result{allocator};
+            auto response = send(method, encodeRequest(uri, method, body, headerFields), timeout, stopTime,
+                                 nullptr, -1, &result);
+            result.status = std::move(response.status);
+            return result;
+        }
+
+        // Writes the response body to the file (at its current position) instead of memory,
+        // the returned response has the status and the header fields, but no body.
+        // The body of a response that isn't successful (2xx) is usually an error message, so it is returned
+        // in the response instead, unless writeErrorBody is set.
+        // Throws if the connection is closed before the whole body has arrived.
+        // On Linux a successful body with a known length is moved from the socket to the file with splice,
+        // chunked bodies and the data received together with the header are written from a buffer.
+        Response download(const int fileDescriptor,
+                          const std::string& method = "GET",
+                          const HeaderFields& headerFields = {},
+                          const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1},
+                          const bool writeErrorBody = false)
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            bool writingFile = true;
+            std::vector<std::uint8_t> errorBody;
+
+            ResponseSink sink;
+            sink.headersReceived = [&writingFile, writeErrorBody](const Status& status, const HeaderFields&) {
+                writingFile = writeErrorBody || isSuccessfulStatus(status);
+            };
+            sink.dataReceived = [fileDescriptor, &writingFile, &errorBody](const std::uint8_t* data, const std::size_t size) {
+                if (writingFile)
+                    writeFile(fileDescriptor, data, size);
+                else
+                    errorBody.insert(errorBody.end(), data, data + size);
+            };
+
+            auto response = send(method, encodeRequest(uri, method, std::vector<std::uint8_t>{}, headerFields),
+                                 timeout, stopTime, &sink, fileDescriptor);
+            response.body = std::move(errorBody);
+            return response;
+        }
+
+        // Creates or truncates the file and writes the response body to it
+        Response download(const std::string& path,
+                          const std::string& method = "GET",
+                          const HeaderFields& headerFields = {},
+                          const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1},
+                          const bool writeErrorBody = false)
+        {
+#if defined(_WIN32)
+            const auto file = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            auto file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            while (file == -1 && errno == EINTR)
+                file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+#endif // defined(_WIN32)
+            if (file == -1)
+                throw std::system_error{errno, std::generic_category(), "Failed to open file"};
+
+            Response response;
+            try
+            {
+                response = download(file, method, headerFields, timeout, writeErrorBody);
+            }
+            catch (...)
+            {
+#if defined(_WIN32)
+                _close(file);
+#else
+                ::close(file);
+#endif // defined(_WIN32)
+                throw;
+            }
+
+            // errors of delayed writes can be reported when the file is closed
+#if defined(_WIN32)
+            if (_close(file) == -1)
+#else
+            if (::close(file) == -1 && errno != EINTR)
+#endif // defined(_WIN32)
+                throw std::system_error{errno, std::generic_category(), "Failed to close file"};
+
+            return response;
+        }
+
+        // Sends the file as the body, it is streamed to the socket without being read into memory
+        Response send(const std::string& method,
+                      const FileBody& body,
+                      const HeaderFields& headerFields = {},
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(method, encodeRequest(uri, method, body, headerFields), timeout, stopTime);
+        }
+
+        // Sends each chunk of the body as soon as it is produced, the timeout includes the time spent in the producer
+        Response send(const std::string& method,
+                      const ChunkedBody& body,
+                      const HeaderFields& headerFields = {},
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(method, encodeRequest(uri, method, body, headerFields), timeout, stopTime);
+        }
+
+        // Runs send on the worker pool, the request must outlive the returned future
+        // and must not be used for another request until the future is ready
+        std::future<Response> sendAsync(const std::string& method = "GET",
+                                        const std::string& body = "",
+                                        const HeaderFields& headerFields = {},
+                                        const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1},
+                                        WorkerPool& workerPool = getWorkerPool())
+        {
+            return workerPool.submit([this, method, body, headerFields, timeout]() {
+                return send(method, body, headerFields, timeout);
+            });
+        }
+
+        std::future<Response> sendAsync(const std::string& method,
+                                        const std::vector<uint8_t>& body,
+                                        const HeaderFields& headerFields = {},
+                                        const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1},
+                                        WorkerPool& workerPool = getWorkerPool())
+        {
+            return workerPool.submit([this, method, body, headerFields, timeout]() {
+                return send(method, body, headerFields, timeout);
+            });
+        }
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+        // Coroutine variant of send, which suspends while waiting for the socket instead of blocking the thread,
+        // the coroutine is resumed by passing a function to the executor (e.g. one that posts it to a thread pool).
+        // The request must outlive the returned task and must not be used for another request until it has finished.
+        Task<Response> sendAsync(Executor executor,
+                                 const std::string& method = "GET",
+                                 const std::string& body = "",
+                                 const HeaderFields& headerFields = {},
+                                 const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            return sendBodyAsync(std::move(executor), method, body, headerFields, timeout);
+        }
+
+        Task<Response> sendAsync(Executor executor,
+                                 const std::string& method,
+                                 const std::vector<uint8_t>& body,
+                                 const HeaderFields& headerFields = {},
+                                 const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            return sendBodyAsync(std::move(executor), method, body, headerFields, timeout);
+        }
+
+    private:
+        // the parameters are taken by value, because they have to stay valid while the coroutine is suspended
+        template <class Body>
+        Task<Response> sendBodyAsync(const Executor executor,
+                                     const std::string method,
+                                     const Body body,
+                                     const HeaderFields headerFields,
+                                     const std::chrono::milliseconds timeout)
+        {
+            const auto deadline = (timeout.count() >= 0) ?
+                std::chrono::steady_clock::now() + timeout :
+                std::chrono::steady_clock::time_point::max();
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            const auto request = encodeRequest(uri, method, body, headerFields);
+
+            // the server might have closed the idle connection in the meantime
+            if (connection && !connection->isReusable())
+                connection.reset();
+
+            if (connection)
+            {
+                // only idempotent requests can be retried automatically (RFC 7230, 6.3.1. Retrying Requests)
+                const auto idempotent = isIdempotentMethod(method);
+
+                try
+                {
+                    if (auto response = co_await exchangeAsync(executor, method, request, deadline))
+                        co_return std::move(*response);
+
+                    if (!idempotent)
+                        throw ResponseError{"Connection closed by peer"};
+                }
+                catch (const std::system_error&)
+                {
+                    if (!idempotent) throw;
+                }
+            }
+
+            const auto port = uri.port.empty() ? "80" : uri.port;
+
+            // numeric addresses don't need a lookup
+            std::vector<Address> addresses;
+            try
+            {
+                addresses = lookupAddresses(uri.host, port, internetProtocol, AI_NUMERICHOST);
+            }
+            catch (const std::system_error&)
+            {
+            }
+
+            if (addresses.empty())
+                addresses = co_await lookupAsync(port, deadline, executor);
+
+            // the addresses are tried one after another
+            std::exception_ptr connectError;
+            for (const auto& address : interleaveAddresses(addresses))
+            {
+                std::optional<Socket> socket;
+                auto connected = false;
+                try
+                {
+                    socket.emplace(address.family, socketOptions);
+                    connected = socket->beginConnect(reinterpret_cast<const sockaddr*>(&address.storage), address.size);
+                }
+                catch (const std::system_error&)
+                {
+                    connectError = std::current_exception();
+                    continue;
+                }
+
+                if (!connected)
+                {
+                    co_await SocketAwaiter{socket->getHandle(), POLLOUT, deadline, executor};
+
+                    try
+                    {
+                        socket->finishConnect();
+                    }
+                    catch (const std::system_error&)
+                    {
+                        connectError = std::current_exception();
+                        continue;
+                    }
+                }
+
+                connection.emplace(std::move(*socket));
+                break;
+            }
+
+            if (!connection)
+                std::rethrow_exception(connectError ? connectError : std::make_exception_ptr(ResponseError{"No address to connect to"}));
+
+            auto response = co_await exchangeAsync(executor, method, request, deadline);
+            co_return response ? std::move(*response) : Response{};
+        }
+#endif // defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+
+    private:
+        Response send(const std::string& method,
+                      const RequestMessage& request,
+                      const std::chrono::milliseconds timeout,
+                      const std::chrono::steady_clock::time_point stopTime,
+                      const ResponseSink* sink = nullptr,
+                      const int bodyFile = -1,
+                      CompactResponse* compactResponse = nullptr)
+        {
+            // the parts of a response that were passed to the sink can't be taken back,
+            // so the request is not retried after the sink has seen the status line
+            bool responseStarted = false;
+            ResponseSink trackingSink;
+            if (sink)
+            {
+                trackingSink.statusReceived = [sink, &responseStarted](const Status& status) {
+                    responseStarted = true;
+                    if (sink->statusReceived) sink->statusReceived(status);
+                };
+
+                if (sink->headerFieldReceived)
+                    trackingSink.headerFieldReceived = [sink](const HeaderField& headerField) {
+                        sink->headerFieldReceived(headerField);
+                    };
+
+                if (sink->headersReceived)
+                    trackingSink.headersReceived = [sink](const Status& status, const HeaderFields& headerFields) {
+                        sink->headersReceived(status, headerFields);
+                    };
+
+                // an empty dataReceived makes the body be collected into the response
+                if (sink->dataReceived)
+                    trackingSink.dataReceived = [sink](const std::uint8_t* data, const std::size_t size) {
+                        sink->dataReceived(data, size);
+                    };
+            }
+
+            const auto responseSink = sink ? &trackingSink : nullptr;
+
+            // the server might have closed the idle connection in the meantime
+            if (connection && !connection->isReusable())
+                connection.reset();
+
+            if (connection)
+            {
+                // only idempotent requests can be retried automatically (RFC 7230, 6.3.1. Retrying Requests)
+                // and only if their body can be sent again
+                const auto retryable = isIdempotentMethod(method) && request.isReplayable();
+
+                try
+                {
+                    if (auto response = exchange(method, request, timeout, stopTime, 0, responseSink, bodyFile, compactResponse))
+                        return std::move(*response);
+
+                    if (!retryable)
+                        throw ResponseError{"Connection closed by peer"};
+                }
+                catch (const std::system_error&)
+                {
+                    if (!retryable || responseStarted) throw;
+                }
+            }
+
+            const auto port = uri.port.empty() ? "80" : uri.port;
+            const std::chrono::milliseconds remainingTime{(timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1};
+            const auto addresses = resolver ?
+                resolver->resolve(uri.host, port, internetProtocol, remainingTime) :
+                resolve(uri.host, port, internetProtocol, remainingTime.count());
+
+            std::size_t sentSize = 0;
+            if (socketOptions.fastOpen && isIdempotentMethod(method))
+            {
+                auto result = connectFastOpen(interleaveAddresses(addresses), request,
+                                              (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1,
+                                              socketOptions);
+                connection.emplace(std::move(result.first));
+                sentSize = result.second;
+            }
+            else
+                connection.emplace(detail::connect(interleaveAddresses(addresses),
+                                                   (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1,
+                                                   socketOptions));
+
+            auto response = exchange(method, request, timeout, stopTime, sentSize, responseSink, bodyFile, compactResponse);
+            return response ? std::move(*response) : Response{};
+        }
+
+        std::optional<Response> exchange(const std::string& method,
+                                          const RequestMessage& request,
+                                          const std::chrono::milliseconds timeout,
+                                          const std::chrono::steady_clock::time_point stopTime,
+                                          const std::size_t sentSize = 0,
+                                          const ResponseSink* responseSink = nullptr,
+                                          const int bodyFile = -1,
+                                          CompactResponse* compactResponse = nullptr)
+        {
+            try
+            {
+                auto response = detail::exchange(*connection, method, request, timeout, stopTime, sentSize,
+                                                 responseSink, bodyFile, compactResponse);
+                if (!connection->persistent) connection.reset();
+                return response;
+            }
+            catch (...)
+            {
+                connection.reset();
+                throw;
+            }
+        }
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+        LookupAwaiter lookupAsync(const std::string& port,
+                                  const std::chrono::steady_clock::time_point deadline,
+                                  const Executor& executor) const
+        {
+            return LookupAwaiter{[addressResolver = resolver, host = uri.host, port, protocol = internetProtocol]() {
+                return addressResolver ?
+                    addressResolver->resolve(host, port, protocol) :
+                    lookupAddresses(host, port, protocol);
+            }, deadline, executor};
+        }
+
+        // same as exchange, but suspends the coroutine while the socket is not ready
+        Task<std::optional<Response>> exchangeAsync(const Executor& executor,
+                                                    const std::string& method,
+                                                    const RequestMessage& request,
+                                                    const std::chrono::steady_clock::time_point deadline)
+        {
+            try
+            {
+                auto& socket = connection->socket;
+                connection->persistent = false;
+
+                std::size_t sent = 0;
+                std::array<ConstBuffer, 2> buffers;
+                while (sent < request.size())
+                {
+                    const auto count = request.getBuffers(sent, buffers);
+                    if (const auto size = socket.trySend(buffers.data(), count))
+                        sent += *size;
+                    else
+                        co_await SocketAwaiter{socket.getHandle(), POLLOUT, deadline, executor};
+                }
+
+                std::array<std::uint8_t, 4096> tempBuffer;
+                ResponseParser parser{method};
+
+                for (;;)
+                {
+                    const auto size = socket.tryRecv(tempBuffer.data(), tempBuffer.size());
+                    if (!size)
+                    {
+                        co_await SocketAwaiter{socket.getHandle(), POLLIN, deadline, executor};
+                        continue;
+                    }
+
+                    if (*size == 0) // disconnected
+                    {
+                        connection.reset();
+                        if (!parser.hasStarted()) co_return std::nullopt;
+                        co_return std::move(parser.getResponse());
+                    }
+
+                    const auto consumed = parser.parse(tempBuffer.data(), *size);
+
+                    if (parser.isComplete())
+                    {
+                        // the connection can't be reused if the server sent something after the response
+                        updatePersistence(*connection, parser.getResponse());
+                        if (consumed != *size || !connection->persistent) connection.reset();
+
+                        co_return std::move(parser.getResponse());
+                    }
+                }
+            }
+            catch (...)
+            {
+                connection.reset();
+                throw;
+            }
+        }
+#endif // defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+
+#if defined(_WIN32) || defined(__CYGWIN__)
+        winsock::Api winSock;
+#endif // defined(_WIN32) || defined(__CYGWIN__)
+        InternetProtocol internetProtocol;
+        Uri uri;
+        std::shared_ptr<Resolver> resolver;
+        SocketOptions socketOptions;
+        std::optional<Connection> connection;
+    };
+
+    struct BatchRequest final
+    {
+        // every item of a batch must refer to a different request object
+        Request& request;
+        std::string method = "GET";
+        std::vector<uint8_t> body;
+        HeaderFields headerFields;
+    };
+
+    struct BatchResult final
+    {
+        Response response;
+        std::exception_ptr error; // set if the request has failed
+    };
+
+    // Sends the requests with at most maxConcurrency of them running at once and returns the results in the same order.
+    // Each worker takes the next request as soon as it is free, so a few slow hosts only hold up the workers waiting for them.
+    // The calling thread is one of the workers.
+    inline std::vector<BatchResult> sendAll(const std::vector<BatchRequest>& requests,
+                                            const std::size_t maxConcurrency = 16,
+                                            const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+    {
+        std::vector<BatchResult> results(requests.size());
+        std::atomic<std::size_t> nextRequest{0};
+
+        const auto work = [&requests, &results, &nextRequest, timeout]() noexcept {
+            for (auto i = nextRequest++; i < requests.size(); i = nextRequest++)
+            {
+                auto& item = requests[i];
+                try
+                {
+                    results[i].response = item.request.send(item.method, item.body, item.headerFields, timeout);
+                }
+                catch (...)
+                {
+                    results[i].error = std::current_exception();
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        const auto workerCount = (std::min)((std::max)(maxConcurrency, std::size_t{1}), requests.size());
+        for (std::size_t i = 1; i < workerCount; ++i)
+        {
+            try
+            {
+                workers.emplace_back(work);
+            }
+            catch (const std::system_error&)
+            {
+                break; // continue with the workers that could be started
+            }
+        }
+
+        work();
+
+        for (auto& worker : workers)
+            worker.join();
+
+        return results;
+    }
+
+    struct ClientOptions final
+    {
+        // the maximum number of idle connections kept per scheme, host and port
+        std::size_t maxIdleConnectionsPerHost = 8;
+        // idle connections are closed after this time, a negative value keeps them until the server closes them
+        std::chrono::milliseconds idleTimeout = std::chrono::seconds{30};
+        // optional shared address cache, host names are looked up on every new connection without it
+        std::shared_ptr<Resolver> resolver;
+        // the maximum number of pipelined requests waiting for a response on a connection
+        std::size_t pipelineDepth = 8;
+        // applied to every new connection
+        SocketOptions socketOptions;
+    };
+
+    // Thread-safe HTTP client which reuses connections through a pool of idle connections per origin
+    class Client final
+    {
+    public:
+        explicit Client(const InternetProtocol protocol = InternetProtocol::v4,
+                        const ClientOptions& options = {}):
+            internetProtocol{protocol},
+            resolver{options.resolver},
+            pipelineDepth{options.pipelineDepth},
+            socketOptions{options.socketOptions},
+            pool{options.maxIdleConnectionsPerHost, options.idleTimeout}
+        {
+        }
+
+        // paths (starting with "/") are resolved against the base URI
+        explicit Client(const std::string& baseUriString,
+                        const InternetProtocol protocol = InternetProtocol::v4,
+                        const ClientOptions& options = {}):
+            internetProtocol{protocol},
+            baseUri{parseUri(baseUriString.begin(), baseUriString.end())},
+            resolver{options.resolver},
+            pipelineDepth{options.pipelineDepth},
+            socketOptions{options.socketOptions},
+            pool{options.maxIdleConnectionsPerHost, options.idleTimeout}
+        {
+        }
+
+        Response send(const std::string& uriString,
+                      const std::string& method = "GET",
+                      const std::string& body = "",
+                      const HeaderFields& headerFields = {},
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            const auto uri = parseUriReference(baseUri, uriString);
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(uri, method, encodeRequest(uri, method, body, headerFields), timeout, stopTime);
+        }
+
+        Response send(const std::string& uriString,
+                      const std::string& method,
+                      const std::vector<uint8_t>& body,
+                      const HeaderFields& headerFields = {},
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            const auto uri = parseUriReference(baseUri, uriString);
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(uri, method, encodeRequest(uri, method, body, headerFields), timeout, stopTime);
+        }
+
+        // Sends the file as the body, it is streamed to the socket without being read into memory
+        Response send(const std::string& uriString,
+                      const std::string& method,
+                      const FileBody& body,
+                      const HeaderFields& headerFields = {},
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            const auto uri = parseUriReference(baseUri, uriString);
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(uri, method, encodeRequest(uri, method, body, headerFields), timeout, stopTime);
+        }
+
+        // Sends each chunk of the body as soon as it is produced, the timeout includes the time spent in the producer
+        Response send(const std::string& uriString,
+                      const std::string& method,
+                      const ChunkedBody& body,
+                      const HeaderFields& headerFields = {},
+                      const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            const auto uri = parseUriReference(baseUri, uriString);
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            return send(uri, method, encodeRequest(uri, method, body, headerFields), timeout, stopTime);
+        }
+
+        // Sends the requests to a single origin over one connection without waiting for the previous responses,
+        // the responses are returned in the order of the requests.
+        // Only idempotent methods are allowed, so that the unanswered requests can be sent again
+        // on a new connection when the server closes the connection in the middle of the pipeline.
+        std::vector<Response> sendPipelined(const std::vector<std::string>& uriStrings,
+                                            const std::string& method = "GET",
+                                            const HeaderFields& headerFields = {},
+                                            const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            const auto stopTime = std::chrono::steady_clock::now() + timeout;
+
+            if (!isIdempotentMethod(method))
+                throw RequestError{"Only idempotent requests can be pipelined"};
+
+            std::vector<Response> responses;
+            if (uriStrings.empty()) return responses;
+
+            Uri firstUri;
+            std::string origin;
+            std::vector<std::vector<std::uint8_t>> requests;
+            requests.reserve(uriStrings.size());
+
+            for (const auto& uriString : uriStrings)
+            {
+                const auto uri = parseUriReference(baseUri, uriString);
+
+                if (uri.scheme != "http")
+                    throw RequestError{"Only HTTP scheme is supported"};
+
+                const auto uriOrigin = uri.scheme + "://" + uri.host + ':' + (uri.port.empty() ? "80" : uri.port);
+                if (requests.empty())
+                {
+                    firstUri = uri;
+                    origin = uriOrigin;
+                }
+                else if (uriOrigin != origin)
+                    throw RequestError{"Pipelined requests must have the same origin"};
+
+                requests.push_back(encodeHtml(uri, method, {}, headerFields));
+            }
+
+            responses.reserve(requests.size());
+
+            while (responses.size() < requests.size())
+            {
+                auto connection = pool.acquire(origin);
+                const auto reused = connection.has_value();
+                if (!connection) connection.emplace(connect(firstUri, timeout, stopTime));
+
+                const auto answered = responses.size();
+
+                try
+                {
+                    exchangePipelined(*connection, method, requests, pipelineDepth, timeout, stopTime, responses);
+                }
+                catch (const std::system_error&)
+                {
+                    // a reused connection might have been closed by the server while it was idle
+                    if (!reused && responses.size() == answered) throw;
+                    continue;
+                }
+
+                // a new connection which was closed without any response would fail again
+                if (!reused && responses.size() == answered)
+                    throw ResponseError{"Connection closed by peer"};
+
+                if (responses.size() == requests.size())
+                    pool.release(origin, std::move(*connection));
+            }
+
+            return responses;
+        }
+
+        // closes all idle connections
+        void clear()
+        {
+            pool.clear();
+        }
+
+    private:
+        Response send(const Uri& uri,
+                      const std::string& method,
+                      const RequestMessage& request,
+                      const std::chrono::milliseconds timeout,
+                      const std::chrono::steady_clock::time_point stopTime)
+        {
+            const auto origin = uri.scheme + "://" + uri.host + ':' + (uri.port.empty() ? "80" : uri.port);
+
+            if (auto connection = pool.acquire(origin))
+            {
+                // only idempotent requests can be retried automatically (RFC 7230, 6.3.1. Retrying Requests)
+                // and only if their body can be sent again
+                const auto retryable = isIdempotentMethod(method) && request.isReplayable();
+
+                try
+                {
+                    if (auto response = exchange(*connection, method, request, timeout, stopTime))
+                    {
+                        pool.release(origin, std::move(*connection));
+                        return std::move(*response);
+                    }
+
+                    if (!retryable)
+                        throw ResponseError{"Connection closed by peer"};
+                }
+                catch (const std::system_error&)
+                {
+                    if (!retryable) throw;
+                }
+            }
+
+            std::size_t sentSize = 0;
+            auto connection = connect(uri, timeout, stopTime,
+                                      (socketOptions.fastOpen && isIdempotentMethod(method)) ? &request : nullptr,
+                                      sentSize);
+
+            auto response = exchange(connection, method, request, timeout, stopTime, sentSize);
+            if (!response) return Response{};
+
+            pool.release(origin, std::move(connection));
+            return std::move(*response);
+        }
+
+        Connection connect(const Uri& uri,
+                           const std::chrono::milliseconds timeout,
+                           const std::chrono::steady_clock::time_point stopTime)
+        {
+            std::size_t sentSize = 0;
+            return connect(uri, timeout, stopTime, nullptr, sentSize);
+        }
+
+        // sends the beginning of the request in the SYN if it is given and reports how much of it was sent
+        Connection connect(const Uri& uri,
+                           const std::chrono::milliseconds timeout,
+                           const std::chrono::steady_clock::time_point stopTime,
+                           const RequestMessage* fastOpenRequest,
+                           std::size_t& sentSize)
+        {
+            const auto port = uri.port.empty() ? "80" : uri.port;
+            const std::chrono::milliseconds remainingTime{(timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1};
+            const auto addresses = resolver ?
+                resolver->resolve(uri.host, port, internetProtocol, remainingTime) :
+                resolve(uri.host, port, internetProtocol, remainingTime.count());
+
+            if (fastOpenRequest)
+            {
+                auto result = connectFastOpen(interleaveAddresses(addresses), *fastOpenRequest,
+                                              (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1,
+                                              socketOptions);
+                sentSize = result.second;
+                return Connection{std::move(result.first)};
+            }
+
+            sentSize = 0;
+            return Connection{detail::connect(interleaveAddresses(addresses),
+                                              (timeout.count() >= 0) ? getRemainingMilliseconds(stopTime) : -1,
+                                              socketOptions)};
+        }
+
+#if defined(_WIN32) || defined(__CYGWIN__)
         winsock::Api winSock;
 #endif // defined(_WIN32) || defined(__CYGWIN__)
         InternetProtocol internetProtocol;
-        Uri uri;
+        Uri baseUri;
+        std::shared_ptr<Resolver> resolver;
+        std::size_t pipelineDepth;
+        SocketOptions socketOptions;
+        ConnectionPool pool;
+    };
+
+#if defined(__linux__)
+    // Drives many requests concurrently on a single thread, either with epoll and edge-triggered non-blocking sockets
+    // or with io_uring, which batches the connect, send and receive operations into few system calls.
+    // Requests must be added from the thread that runs the loop (or before running it),
+    // use one event loop per thread to spread the requests over several threads.
+    class EventLoop final
+    {
+    public:
+        using Callback = std::function<void(Response response, std::exception_ptr error)>;
+
+        enum class Backend: std::uint8_t
+        {
+            epoll,
+            ioUring // falls back to epoll if io_uring is not available (Linux 5.11 or newer is required)
+        };
+
+        explicit EventLoop(const InternetProtocol protocol = InternetProtocol::v4,
+                           std::shared_ptr<Resolver> addressResolver = nullptr,
+                           const Backend requestedBackend = Backend::epoll,
+                           const SocketOptions& options = {}):
+            internetProtocol{protocol},
+            resolver{std::move(addressResolver)},
+            socketOptions{options},
+            lookups{std::make_shared<Lookups>()}
+        {
+#if defined(IORING_ENTER_EXT_ARG)
+            if (requestedBackend == Backend::ioUring)
+            {
+                try
+                {
+                    ring = std::make_unique<IoUring>(256, 64, 16384);
+                    backend = Backend::ioUring;
+                    watchLookups();
+                    return;
+                }
+                catch (const std::system_error&)
+                {
+                    // io_uring is missing or disabled (e.g. by a seccomp filter)
+                    ring.reset();
+                }
+            }
+#else
+            static_cast<void>(requestedBackend);
+#endif // defined(IORING_ENTER_EXT_ARG)
+
+            endpoint = epoll_create1(EPOLL_CLOEXEC);
+            if (endpoint == -1)
+                throw std::system_error{errno, std::system_category(), "Failed to create epoll instance"};
+
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = 0; // transaction IDs start from 1
+            if (epoll_ctl(endpoint, EPOLL_CTL_ADD, lookups->eventDescriptor, &event) == -1)
+            {
+                ::close(endpoint);
+                throw std::system_error{errno, std::system_category(), "Failed to add event descriptor to epoll"};
+            }
+        }
+
+        ~EventLoop()
+        {
+#if defined(IORING_ENTER_EXT_ARG)
+            // the kernel may still write to the buffers of the transactions, so their operations have to be finished first
+            if (ring)
+            {
+                try
+                {
+                    for (const auto& transaction : transactions)
+                        if (transaction.second->operationPending) cancel(*transaction.second);
+
+                    while (pendingOperations > 0)
+                    {
+                        ring->submitAndWait(-1);
+                        for (const auto& completion : ring->reapCompletions())
+                        {
+                            const auto transactionIterator = transactions.find(completion.userData);
+                            if (transactionIterator != transactions.end() && transactionIterator->second->operationPending)
+                            {
+                                transactionIterator->second->operationPending = false;
+                                --pendingOperations;
+                            }
+                        }
+                    }
+                }
+                catch (...)
+                {
+                }
+            }
+#endif // defined(IORING_ENTER_EXT_ARG)
+
+            transactions.clear();
+            if (endpoint != -1) ::close(endpoint);
+        }
+
+        EventLoop(const EventLoop&) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+
+        void send(const std::string& uriString,
+                  const std::string& method,
+                  const std::string& body,
+                  const HeaderFields& headerFields,
+                  const std::chrono::milliseconds timeout,
+                  Callback callback)
+        {
+            // the only copy of the body is moved into the transaction
+            send(uriString,
+                 method,
+                 std::vector<uint8_t>(body.begin(), body.end()),
+                 headerFields,
+                 timeout,
+                 std::move(callback));
+        }
+
+        // the callback is called from poll or run when the request has finished or failed,
+        // the body is taken by value, because the transaction keeps it until the request has been sent
+        void send(const std::string& uriString,
+                  const std::string& method,
+                  std::vector<uint8_t> body,
+                  const HeaderFields& headerFields,
+                  const std::chrono::milliseconds timeout,
+                  Callback callback)
+        {
+            auto uri = parseUri(uriString.begin(), uriString.end());
+
+            if (uri.scheme != "http")
+                throw RequestError{"Only HTTP scheme is supported"};
+
+            auto transaction = std::make_unique<Transaction>();
+            transaction->id = ++lastTransactionId;
+            transaction->origin = uri.scheme + "://" + uri.host + ':' + (uri.port.empty() ? "80" : uri.port);
+            transaction->body = std::move(body);
+            transaction->request = encodeRequest(uri, method, transaction->body, headerFields);
+            transaction->uri = std::move(uri);
+            transaction->method = method;
+            transaction->parser.emplace(method);
+            transaction->callback = std::move(callback);
+
+            if (timeout.count() >= 0)
+                transaction->deadline = deadlines.emplace(std::chrono::steady_clock::now() + timeout, transaction->id);
+            else
+                transaction->deadline = deadlines.end();
+
+            // the request is started from poll, so that the callback is never called from send
+            startQueue.push_back(transaction->id);
+            transactions.emplace(transaction->id, std::move(transaction));
+        }
+
+        // waits for events at most the given time (or indefinitely if the timeout is negative) and processes them,
+        // returns the number of unfinished requests
+        std::size_t poll(const std::chrono::milliseconds timeout = std::chrono::milliseconds{-1})
+        {
+            // the callbacks left over after one of them has thrown
+            runCallbacks();
+
+            while (!startQueue.empty())
+            {
+                const auto transactionId = startQueue.front();
+                startQueue.pop_front();
+
+                const auto transactionIterator = transactions.find(transactionId);
+                if (transactionIterator != transactions.end())
+                    start(*transactionIterator->second);
+            }
+
+            // requests that have failed to start are reported without waiting
+            auto waitTime = completions.empty() ? timeout.count() : 0;
+            if (!deadlines.empty())
+            {
+                const auto deadlineTime = getRemainingMilliseconds(deadlines.begin()->first);
+                waitTime = (waitTime >= 0) ? (std::min)(waitTime, deadlineTime) : deadlineTime;
+            }
+
+#if defined(IORING_ENTER_EXT_ARG)
+            if (ring)
+            {
+                ring->submitAndWait(waitTime);
+
+                for (const auto& completion : ring->reapCompletions())
+                {
+                    if (completion.userData == 0)
+                    {
+                        finishLookups();
+                        watchLookups();
+                        continue;
+                    }
+
+                    const auto transactionIterator = transactions.find(completion.userData);
+                    if (transactionIterator != transactions.end())
+                        handleCompletion(*transactionIterator->second, completion.result);
+                }
+            }
+            else
+#endif // defined(IORING_ENTER_EXT_ARG)
+            {
+                std::array<epoll_event, 256> events;
+                const auto count = epoll_wait(endpoint, events.data(), static_cast<int>(events.size()),
+                                              static_cast<int>((std::min)(waitTime, std::int64_t{INT32_MAX})));
+                if (count == -1 && errno != EINTR)
+                    throw std::system_error{errno, std::system_category(), "Failed to wait for events"};
+
+                for (int i = 0; i < count; ++i)
+                {
+                    if (events[i].data.u64 == 0)
+                    {
+                        finishLookups();
+                        continue;
+                    }
+
+                    const auto transactionIterator = transactions.find(events[i].data.u64);
+                    if (transactionIterator != transactions.end())
+                        progress(*transactionIterator->second, events[i].events);
+                }
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            while (!deadlines.empty() && deadlines.begin()->first <= now)
+            {
+                const auto transactionIterator = transactions.find(deadlines.begin()->second);
+                expire(*transactionIterator->second);
+            }
+
+            runCallbacks();
+
+            return transactions.size();
+        }
+
+        // processes events until all the requests have finished,
+        // an exception thrown by a callback is passed on and the loop can be run again afterwards
+        void run()
+        {
+            while (!transactions.empty() || !completions.empty())
+                poll();
+        }
+
+        std::size_t getPendingCount() const noexcept
+        {
+            return transactions.size();
+        }
+
+        Backend getBackend() const noexcept
+        {
+            return backend;
+        }
+
+    private:
+        struct Transaction final
+        {
+            enum class State
+            {
+                resolving,
+                connecting,
+                sending,
+                receiving
+            };
+
+            std::uint64_t id = 0;
+            State state = State::resolving;
+            Uri uri;
+            std::string origin;
+            std::string method;
+            std::vector<std::uint8_t> body;
+            RequestMessage request; // refers to the body
+            std::size_t sent = 0;
+            std::vector<Address> addresses;
+            std::size_t nextAddress = 0;
+            std::exception_ptr connectError;
+            std::optional<Connection> connection;
+            bool reused = false;
+            std::optional<ResponseParser> parser;
+            std::multimap<std::chrono::steady_clock::time_point, std::uint64_t>::iterator deadline;
+            Callback callback;
+            // io_uring only
+            bool operationPending = false;
+            std::exception_ptr cancelError; // reported once the cancelled operation has completed
+            std::optional<std::uint16_t> bufferIndex; // registered receive buffer
+            std::vector<std::uint8_t> receiveBuffer; // used when all the registered buffers are taken
+            msghdr sendMessage{}; // must stay valid until the send has completed
+            std::array<iovec, 2> sendVectors{};
+        };
+
+        // the result of a finished transaction, which is passed to its callback after the events have been processed
+        struct Completion final
+        {
+            Callback callback;
+            Response response;
+            std::exception_ptr error;
+        };
+
+        // host name lookups run on the lookup pool and report back through the event descriptor,
+        // the state is shared with them, because they can outlive the event loop
+        struct Lookups final
+        {
+            struct Result final
+            {
+                std::uint64_t transactionId;
+                std::vector<Address> addresses;
+                std::exception_ptr error;
+            };
+
+            Lookups():
+                eventDescriptor{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+            {
+                if (eventDescriptor == -1)
+                    throw std::system_error{errno, std::system_category(), "Failed to create event descriptor"};
+            }
+
+            ~Lookups()
+            {
+                ::close(eventDescriptor);
+            }
+
+            Lookups(const Lookups&) = delete;
+            Lookups& operator=(const Lookups&) = delete;
+
+            void push(Result result)
+            {
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    results.push_back(std::move(result));
+                }
+
+                const std::uint64_t value = 1;
+                while (write(eventDescriptor, &value, sizeof(value)) == -1 && errno == EINTR);
+            }
+
+            int eventDescriptor;
+            std::mutex mutex;
+            std::vector<Result> results;
+        };
+
+        void start(Transaction& transaction)
+        {
+            try
+            {
+                if (auto connection = pool.acquire(transaction.origin))
+                {
+                    transaction.reused = true;
+                    attach(transaction, std::move(*connection), Transaction::State::sending);
+                    resume(transaction);
+                }
+                else
+                    resolve(transaction);
+            }
+            catch (...)
+            {
+                fail(transaction, std::current_exception());
+            }
+        }
+
+        void resolve(Transaction& transaction)
+        {
+            transaction.state = Transaction::State::resolving;
+
+            const auto& host = transaction.uri.host;
+            const auto port = transaction.uri.port.empty() ? "80" : transaction.uri.port;
+
+            // numeric addresses don't need a lookup
+            try
+            {
+                transaction.addresses = interleaveAddresses(lookupAddresses(host, port, internetProtocol, AI_NUMERICHOST));
+            }
+            catch (const std::system_error&)
+            {
+                getLookupPool().post([results = lookups,
+                                      addressResolver = resolver,
+                                      transactionId = transaction.id,
+                                      host,
+                                      port,
+                                      protocol = internetProtocol]() {
+                    Lookups::Result result{transactionId, {}, nullptr};
+                    try
+                    {
+                        result.addresses = interleaveAddresses(addressResolver ?
+                                                               addressResolver->resolve(host, port, protocol) :
+                                                               lookupAddresses(host, port, protocol));
+                    }
+                    catch (...)
+                    {
+                        result.error = std::current_exception();
+                    }
+
+                    results->push(std::move(result));
+                });
+                return;
+            }
+
+            connect(transaction);
+        }
+
+        void finishLookups()
+        {
+            std::uint64_t value;
+            while (read(lookups->eventDescriptor, &value, sizeof(value)) == -1 && errno == EINTR);
+
+            std::vector<Lookups::Result> results;
+            {
+                std::lock_guard<std::mutex> lock{lookups->mutex};
+                std::swap(results, lookups->results);
+            }
+
+            for (auto& result : results)
+            {
+                // the request might have timed out in the meantime
+                const auto transactionIterator = transactions.find(result.transactionId);
+                if (transactionIterator == transactions.end()) continue;
+
+                auto& transaction = *transactionIterator->second;
+                if (result.error)
+                    fail(transaction, result.error);
+                else
+                {
+                    transaction.addresses = std::move(result.addresses);
+                    connect(transaction);
+                }
+            }
+        }
+
+        // starts connecting to the next address, failing over to the following one right away on errors
+        void connect(Transaction& transaction)
+        {
+            for (;;)
+            {
+                if (transaction.nextAddress >= transaction.addresses.size())
+                {
+                    fail(transaction, transaction.connectError ?
+                         transaction.connectError :
+                         std::make_exception_ptr(ResponseError{"No address to connect to"}));
+                    return;
+                }
+
+                const auto& address = transaction.addresses[transaction.nextAddress++];
+
+                try
+                {
+                    Socket socket{address.family, socketOptions};
+
+                    if (backend == Backend::ioUring)
+                    {
+                        attach(transaction, Connection{std::move(socket)}, Transaction::State::connecting);
+                        resume(transaction);
+                        return;
+                    }
+
+                    const auto connected = socket.beginConnect(reinterpret_cast<const sockaddr*>(&address.storage),
+                                                               address.size);
+                    attach(transaction, Connection{std::move(socket)},
+                           connected ? Transaction::State::sending : Transaction::State::connecting);
+
+                    if (connected) progress(transaction, 0);
+                    return;
+                }
+                catch (const std::system_error&)
+                {
+                    transaction.connectError = std::current_exception();
+                }
+            }
+        }
+
+        void attach(Transaction& transaction, Connection connection, const Transaction::State state)
+        {
+            detach(transaction);
+
+            if (backend == Backend::epoll)
+            {
+                epoll_event event{};
+                event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                event.data.u64 = transaction.id;
+                if (epoll_ctl(endpoint, EPOLL_CTL_ADD, connection.socket.getHandle(), &event) == -1)
+                    throw std::system_error{errno, std::system_category(), "Failed to add socket to epoll"};
+            }
+
+            transaction.connection.emplace(std::move(connection));
+            transaction.state = state;
+        }
+
+        // must not be called while an io_uring operation on the socket is pending
+        void detach(Transaction& transaction) noexcept
+        {
+            if (transaction.connection)
+            {
+                if (backend == Backend::epoll)
+                    epoll_ctl(endpoint, EPOLL_CTL_DEL, transaction.connection->socket.getHandle(), nullptr);
+                transaction.connection.reset();
+            }
+        }
+
+        // continues a transaction that has just been given a connection
+        void resume(Transaction& transaction)
+        {
+#if defined(IORING_ENTER_EXT_ARG)
+            if (ring)
+            {
+                submit(transaction);
+                return;
+            }
+#endif // defined(IORING_ENTER_EXT_ARG)
+            progress(transaction, 0);
+        }
+
+        // advances the transaction as far as the socket allows without blocking
+        void progress(Transaction& transaction, const std::uint32_t events)
+        {
+            try
+            {
+                if (transaction.state == Transaction::State::connecting)
+                {
+                    if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) return;
+
+                    try
+                    {
+                        transaction.connection->socket.finishConnect();
+                    }
+                    catch (const std::system_error&)
+                    {
+                        transaction.connectError = std::current_exception();
+                        detach(transaction);
+                        connect(transaction);
+                        return;
+                    }
+
+                    transaction.state = Transaction::State::sending;
+                }
+
+                if (transaction.state == Transaction::State::sending)
+                {
+                    std::array<ConstBuffer, 2> buffers;
+                    while (transaction.sent < transaction.request.size())
+                    {
+                        const auto count = transaction.request.getBuffers(transaction.sent, buffers);
+                        const auto size = transaction.connection->socket.trySend(buffers.data(), count);
+                        if (!size) return;
+                        transaction.sent += *size;
+                    }
+
+                    transaction.state = Transaction::State::receiving;
+                }
+
+                if (transaction.state == Transaction::State::receiving)
+                {
+                    // edge-triggered events require reading until the socket would block
+                    for (;;)
+                    {
+                        const auto size = transaction.connection->socket.tryRecv(receiveBuffer.data(), receiveBuffer.size());
+                        if (!size || !receive(transaction, receiveBuffer.data(), *size)) return;
+                    }
+                }
+            }
+            catch (const std::system_error&)
+            {
+                if (canRetry(transaction))
+                    retry(transaction);
+                else
+                    fail(transaction, std::current_exception());
+            }
+            catch (...)
+            {
+                fail(transaction, std::current_exception());
+            }
+        }
+
+        // passes the received data to the parser, returns false if the transaction has finished
+        bool receive(Transaction& transaction, const std::uint8_t* data, const std::size_t size)
+        {
+            auto& parser = *transaction.parser;
+
+            if (size == 0) // disconnected
+            {
+                if (parser.hasStarted())
+                    finish(transaction, false);
+                else if (canRetry(transaction))
+                    retry(transaction);
+                else if (transaction.reused)
+                    fail(transaction, std::make_exception_ptr(ResponseError{"Connection closed by peer"}));
+                else
+                    finish(transaction, false);
+                return false;
+            }
+
+            const auto consumed = parser.parse(data, size);
+            if (parser.isComplete())
+            {
+                // the connection can't be reused if the server sent something after the response
+                finish(transaction, consumed == size);
+                return false;
+            }
+
+            return true;
+        }
+
+#if defined(IORING_ENTER_EXT_ARG)
+        // queues the operation for the current state of the transaction, only one is pending at a time
+        void submit(Transaction& transaction)
+        {
+            auto& entry = ring->getSubmission();
+            entry.fd = transaction.connection->socket.getHandle();
+            entry.user_data = transaction.id;
+
+            switch (transaction.state)
+            {
+                case Transaction::State::connecting:
+                {
+                    const auto& address = transaction.addresses[transaction.nextAddress - 1];
+                    entry.opcode = IORING_OP_CONNECT;
+                    entry.addr = reinterpret_cast<std::uint64_t>(&address.storage);
+                    entry.off = static_cast<std::uint64_t>(address.size);
+                    break;
+                }
+                case Transaction::State::sending:
+                {
+                    std::array<ConstBuffer, 2> buffers;
+                    const auto count = transaction.request.getBuffers(transaction.sent, buffers);
+                    for (std::size_t i = 0; i < count; ++i)
+                        transaction.sendVectors[i] = iovec{const_cast<void*>(buffers[i].data), buffers[i].size};
+
+                    transaction.sendMessage = msghdr{};
+                    transaction.sendMessage.msg_iov = transaction.sendVectors.data();
+                    transaction.sendMessage.msg_iovlen = count;
+
+                    entry.opcode = IORING_OP_SENDMSG;
+                    entry.addr = reinterpret_cast<std::uint64_t>(&transaction.sendMessage);
+                    entry.len = 1;
+                    entry.msg_flags = MSG_NOSIGNAL;
+                    break;
+                }
+                case Transaction::State::receiving:
+                    if (!transaction.bufferIndex && transaction.receiveBuffer.empty())
+                    {
+                        transaction.bufferIndex = ring->acquireBuffer();
+                        if (!transaction.bufferIndex) transaction.receiveBuffer.resize(16384);
+                    }
+
+                    if (transaction.bufferIndex)
+                    {
+                        entry.opcode = IORING_OP_READ_FIXED;
+                        entry.addr = reinterpret_cast<std::uint64_t>(ring->getBuffer(*transaction.bufferIndex));
+                        entry.len = static_cast<std::uint32_t>(ring->getBufferSize());
+                        entry.buf_index = *transaction.bufferIndex;
+                    }
+                    else
+                    {
+                        entry.opcode = IORING_OP_RECV;
+                        entry.addr = reinterpret_cast<std::uint64_t>(transaction.receiveBuffer.data());
+                        entry.len = static_cast<std::uint32_t>(transaction.receiveBuffer.size());
+                    }
+                    break;
+                case Transaction::State::resolving:
+                    break;
+            }
+
+            transaction.operationPending = true;
+            ++pendingOperations;
+        }
+
+        void cancel(Transaction& transaction)
+        {
+            auto& entry = ring->getSubmission();
+            entry.opcode = IORING_OP_ASYNC_CANCEL;
+            entry.fd = -1;
+            entry.addr = transaction.id;
+            entry.user_data = cancelUserData;
+        }
+
+        void handleCompletion(Transaction& transaction, const std::int32_t result)
+        {
+            if (!transaction.operationPending) return;
+            transaction.operationPending = false;
+            --pendingOperations;
+
+            if (transaction.cancelError)
+            {
+                fail(transaction, transaction.cancelError);
+                return;
+            }
+
+            try
+            {
+                // non-blocking sockets may report that the operation would block, it is then just retried
+                if (result == -EAGAIN)
+                {
+                    submit(transaction);
+                    return;
+                }
+
+                switch (transaction.state)
+                {
+                    case Transaction::State::connecting:
+                        if (result < 0)
+                        {
+                            transaction.connectError = std::make_exception_ptr(std::system_error{-result, std::system_category(), "Failed to connect"});
+                            detach(transaction);
+                            connect(transaction);
+                            return;
+                        }
+
+                        transaction.state = Transaction::State::sending;
+                        break;
+                    case Transaction::State::sending:
+                        if (result < 0)
+                            throw std::system_error{-result, std::system_category(), "Failed to send data"};
+
+                        transaction.sent += static_cast<std::size_t>(result);
+                        if (transaction.sent == transaction.request.size())
+                            transaction.state = Transaction::State::receiving;
+                        break;
+                    case Transaction::State::receiving:
+                    {
+                        if (result < 0)
+                            throw std::system_error{-result, std::system_category(), "Failed to read data"};
+
+                        const auto data = transaction.bufferIndex ?
+                            ring->getBuffer(*transaction.bufferIndex) :
+                            transaction.receiveBuffer.data();
+                        if (!receive(transaction, data, static_cast<std::size_t>(result))) return;
+                        break;
+                    }
+                    case Transaction::State::resolving:
+                        return;
+                }
+
+                submit(transaction);
+            }
+            catch (const std::system_error&)
+            {
+                if (canRetry(transaction))
+                    retry(transaction);
+                else
+                    fail(transaction, std::current_exception());
+            }
+            catch (...)
+            {
+                fail(transaction, std::current_exception());
+            }
+        }
+
+        // the event descriptor is polled with a one-shot operation, which is renewed after each completion
+        void watchLookups()
+        {
+            auto& entry = ring->getSubmission();
+            entry.opcode = IORING_OP_POLL_ADD;
+            entry.fd = lookups->eventDescriptor;
+            entry.poll32_events = POLLIN;
+            entry.user_data = 0; // transaction IDs start from 1
+        }
+#endif // defined(IORING_ENTER_EXT_ARG)
+
+        void expire(Transaction& transaction)
+        {
+            const auto error = std::make_exception_ptr(ResponseError{"Request timed out"});
+
+#if defined(IORING_ENTER_EXT_ARG)
+            // the kernel may still use the buffers of a pending operation, so the error is reported after it has been cancelled
+            if (transaction.operationPending)
+            {
+                deadlines.erase(transaction.deadline);
+                transaction.deadline = deadlines.end();
+                if (!transaction.cancelError)
+                {
+                    transaction.cancelError = error;
+                    cancel(transaction);
+                }
+                return;
+            }
+#endif // defined(IORING_ENTER_EXT_ARG)
+
+            fail(transaction, error);
+        }
+
+        // only idempotent requests on reused connections without any response are retried (RFC 7230, 6.3.1. Retrying Requests)
+        static bool canRetry(const Transaction& transaction) noexcept
+        {
+            return transaction.reused &&
+                !transaction.parser->hasStarted() &&
+                isIdempotentMethod(transaction.method);
+        }
+
+        void retry(Transaction& transaction)
+        {
+            detach(transaction);
+            transaction.reused = false;
+            transaction.sent = 0;
+            transaction.parser.emplace(transaction.method);
+            resolve(transaction);
+        }
+
+        void finish(Transaction& transaction, const bool reusable)
+        {
+            auto& response = transaction.parser->getResponse();
+
+            if (transaction.connection && transaction.parser->isComplete())
+            {
+                updatePersistence(*transaction.connection, response);
+                if (reusable && transaction.connection->persistent)
+                {
+                    if (backend == Backend::epoll)
+                        epoll_ctl(endpoint, EPOLL_CTL_DEL, transaction.connection->socket.getHandle(), nullptr);
+                    pool.release(transaction.origin, std::move(*transaction.connection));
+                    transaction.connection.reset();
+                }
+            }
+
+            complete(transaction, std::move(response), nullptr);
+        }
+
+        void fail(Transaction& transaction, const std::exception_ptr error)
+        {
+            complete(transaction, Response{}, error);
+        }
+
+        // Removes the transaction and queues its callback with the result, which is called by runCallbacks
+        // once the transaction is no longer used, so that the callback can add new requests or throw
+        void complete(Transaction& transaction, Response response, const std::exception_ptr error)
+        {
+            detach(transaction);
+            if (transaction.deadline != deadlines.end()) deadlines.erase(transaction.deadline);
+#if defined(IORING_ENTER_EXT_ARG)
+            if (transaction.bufferIndex) ring->releaseBuffer(*transaction.bufferIndex);
+#endif // defined(IORING_ENTER_EXT_ARG)
+
+            completions.push_back(Completion{std::move(transaction.callback), std::move(response), error});
+            const auto transactionId = transaction.id;
+            transactions.erase(transactionId);
+        }
+
+        // calls the callbacks of the finished transactions, the ones after a callback that throws are called by the next poll
+        void runCallbacks()
+        {
+            while (!completions.empty())
+            {
+                auto completion = std::move(completions.front());
+                completions.pop_front();
+                if (completion.callback) completion.callback(std::move(completion.response), completion.error);
+            }
+        }
+
+        InternetProtocol internetProtocol;
+        std::shared_ptr<Resolver> resolver;
+        SocketOptions socketOptions;
+        std::shared_ptr<Lookups> lookups;
+        Backend backend = Backend::epoll;
+        int endpoint = -1;
+#if defined(IORING_ENTER_EXT_ARG)
+        static constexpr std::uint64_t cancelUserData = UINT64_MAX;
+        std::unique_ptr<IoUring> ring;
+        std::size_t pendingOperations = 0;
+#endif // defined(IORING_ENTER_EXT_ARG)
+        std::uint64_t lastTransactionId = 0;
+        std::unordered_map<std::uint64_t, std::unique_ptr<Transaction>> transactions;
+        std::multimap<std::chrono::steady_clock::time_point, std::uint64_t> deadlines;
+        std::deque<std::uint64_t> startQueue;
+        std::deque<Completion> completions;
+        ConnectionPool pool{8, std::chrono::seconds{30}};
+        std::vector<std::uint8_t> receiveBuffer = std::vector<std::uint8_t>(65536);
     };
+#endif // defined(__linux__)
 }
 
 #endif // HTTPREQUEST_HPP
@@ -0,0 +1,1222 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "catch2/catch.hpp"
+#include "HTTPRequest.hpp"
+#include "server.hpp"
+
+#if !defined(_WIN32) && !defined(__CYGWIN__)
+#  include <fcntl.h>
+#  include <signal.h>
+#endif // !defined(_WIN32) && !defined(__CYGWIN__)
+
+TEST_CASE("Interleave addresses", "[connection]")
+{
+    std::vector<http::Address> addresses(5);
+    addresses[0].family = AF_INET6;
+    addresses[0].size = 1;
+    addresses[1].family = AF_INET6;
+    addresses[1].size = 2;
+    addresses[2].family = AF_INET6;
+    addresses[2].size = 3;
+    addresses[3].family = AF_INET;
+    addresses[3].size = 4;
+    addresses[4].family = AF_INET;
+    addresses[4].size = 5;
+
+    const auto result = http::interleaveAddresses(addresses);
+    REQUIRE(result.size() == 5);
+    REQUIRE(result[0].size == 1);
+    REQUIRE(result[1].size == 4);
+    REQUIRE(result[2].size == 2);
+    REQUIRE(result[3].size == 5);
+    REQUIRE(result[4].size == 3);
+}
+
+TEST_CASE("Resolver override", "[connection]")
+{
+    http::Resolver resolver;
+    resolver.addOverride("Test.Example", "80", "127.0.0.2");
+    resolver.addOverride("test.example", "80", "::1");
+
+    const auto addresses = resolver.resolve("test.example", "80", http::InternetProtocol::any);
+    REQUIRE(addresses.size() == 2);
+    REQUIRE(addresses[0].family == AF_INET);
+    REQUIRE(addresses[1].family == AF_INET6);
+
+    const auto v4Addresses = resolver.resolve("test.example", "80", http::InternetProtocol::v4);
+    REQUIRE(v4Addresses.size() == 1);
+
+    sockaddr_in address;
+    std::memcpy(&address, &v4Addresses[0].storage, sizeof(address));
+    REQUIRE(ntohs(address.sin_port) == 80);
+    REQUIRE(ntohl(address.sin_addr.s_addr) == 0x7F000002);
+
+    REQUIRE_THROWS_AS(resolver.addOverride("test.example", "80", "not an address"), std::system_error);
+}
+
+namespace
+{
+    std::uint32_t getIpv4Address(const http::Address& address)
+    {
+        sockaddr_in result;
+        std::memcpy(&result, &address.storage, sizeof(result));
+        return ntohl(result.sin_addr.s_addr);
+    }
+
+    // a lookup function that counts the lookups and returns the current address or fails
+    struct CountingLookup final
+    {
+        std::vector<http::Address> operator()(const std::string&, const std::string& port, const http::InternetProtocol)
+        {
+            std::lock_guard<std::mutex> lock{state->mutex};
+            ++state->count;
+            state->ports.push_back(port);
+            if (state->address.empty())
+                throw std::system_error{std::make_error_code(std::errc::host_unreachable), "Failed to resolve"};
+            return http::lookupAddresses(state->address, port, http::InternetProtocol::v4, AI_NUMERICHOST);
+        }
+
+        struct State final
+        {
+            std::mutex mutex;
+            std::size_t count = 0;
+            std::vector<std::string> ports;
+            std::string address = "127.0.0.3";
+        };
+
+        std::shared_ptr<State> state = std::make_shared<State>();
+    };
+}
+
+TEST_CASE("Resolver override with another port", "[connection]")
+{
+    CountingLookup lookup;
+    http::ResolverOptions options;
+    options.lookup = lookup;
+
+    http::Resolver resolver{options};
+    resolver.addOverride("test.example", "80", "127.0.0.2");
+
+    // the override is only for port 80, so the name is looked up for port 8080
+    const auto addresses = resolver.resolve("test.example", "8080", http::InternetProtocol::v4);
+    REQUIRE(addresses.size() == 1);
+    REQUIRE(getIpv4Address(addresses[0]) == 0x7F000003);
+
+    sockaddr_in address;
+    std::memcpy(&address, &addresses[0].storage, sizeof(address));
+    REQUIRE(ntohs(address.sin_port) == 8080);
+
+    REQUIRE(lookup.state->count == 1);
+    REQUIRE(lookup.state->ports == std::vector<std::string>{"8080"});
+
+    // port 80 is still overridden
+    const auto overridden = resolver.resolve("test.example", "80", http::InternetProtocol::v4);
+    REQUIRE(overridden.size() == 1);
+    REQUIRE(getIpv4Address(overridden[0]) == 0x7F000002);
+    REQUIRE(lookup.state->count == 1);
+}
+
+TEST_CASE("Resolver cache expires", "[connection]")
+{
+    CountingLookup lookup;
+    http::ResolverOptions options;
+    options.timeToLive = std::chrono::milliseconds{100};
+    options.staleTimeToLive = std::chrono::milliseconds{0};
+    options.lookup = lookup;
+    http::Resolver resolver{options};
+
+    REQUIRE(resolver.resolve("test.example", "80", http::InternetProtocol::v4).size() == 1);
+    REQUIRE(resolver.resolve("test.example", "80", http::InternetProtocol::v4).size() == 1);
+    REQUIRE(lookup.state->count == 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{150});
+    REQUIRE(resolver.resolve("test.example", "80", http::InternetProtocol::v4).size() == 1);
+    REQUIRE(lookup.state->count == 2);
+}
+
+TEST_CASE("Resolver serves stale addresses while refreshing", "[connection]")
+{
+    CountingLookup lookup;
+    http::ResolverOptions options;
+    options.timeToLive = std::chrono::milliseconds{100};
+    options.staleTimeToLive = std::chrono::seconds{60};
+    options.lookup = lookup;
+    http::Resolver resolver{options};
+
+    REQUIRE(getIpv4Address(resolver.resolve("test.example", "80", http::InternetProtocol::v4).at(0)) == 0x7F000003);
+
+    {
+        std::lock_guard<std::mutex> lock{lookup.state->mutex};
+        lookup.state->address = "127.0.0.4";
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{150});
+
+    // the expired address is returned right away and refreshed in the background
+    REQUIRE(getIpv4Address(resolver.resolve("test.example", "80", http::InternetProtocol::v4).at(0)) == 0x7F000003);
+
+    const auto waitTime = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    std::uint32_t address = 0;
+    while ((address = getIpv4Address(resolver.resolve("test.example", "80", http::InternetProtocol::v4).at(0))) != 0x7F000004 &&
+           std::chrono::steady_clock::now() < waitTime)
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+
+    REQUIRE(address == 0x7F000004);
+    REQUIRE(lookup.state->count == 2);
+}
+
+TEST_CASE("Resolver backs off after a failed refresh", "[connection]")
+{
+    CountingLookup lookup;
+    http::ResolverOptions options;
+    options.timeToLive = std::chrono::milliseconds{100};
+    options.staleTimeToLive = std::chrono::seconds{60};
+    options.negativeTimeToLive = std::chrono::milliseconds{300};
+    options.lookup = lookup;
+    http::Resolver resolver{options};
+
+    REQUIRE(resolver.resolve("test.example", "80", http::InternetProtocol::v4).size() == 1);
+
+    {
+        std::lock_guard<std::mutex> lock{lookup.state->mutex};
+        lookup.state->address.clear();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{150});
+
+    const auto getCount = [&lookup]() {
+        std::lock_guard<std::mutex> lock{lookup.state->mutex};
+        return lookup.state->count;
+    };
+
+    // the stale address is served while the refresh fails
+    REQUIRE(getIpv4Address(resolver.resolve("test.example", "80", http::InternetProtocol::v4).at(0)) == 0x7F000003);
+    const auto waitTime = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    while (getCount() < 2 && std::chrono::steady_clock::now() < waitTime)
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    REQUIRE(getCount() == 2);
+
+    // the failed refresh is not retried before the negative time to live has passed
+    for (int i = 0; i < 10; ++i)
+    {
+        REQUIRE(getIpv4Address(resolver.resolve("test.example", "80", http::InternetProtocol::v4).at(0)) == 0x7F000003);
+        std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    }
+    REQUIRE(getCount() == 2);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{350});
+    REQUIRE(getIpv4Address(resolver.resolve("test.example", "80", http::InternetProtocol::v4).at(0)) == 0x7F000003);
+    while (getCount() < 3 && std::chrono::steady_clock::now() < waitTime)
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    REQUIRE(getCount() == 3);
+}
+
+TEST_CASE("Resolver caches failures", "[connection]")
+{
+    CountingLookup lookup;
+    lookup.state->address.clear();
+    http::ResolverOptions options;
+    options.negativeTimeToLive = std::chrono::milliseconds{100};
+    options.lookup = lookup;
+    http::Resolver resolver{options};
+
+    REQUIRE_THROWS_AS(resolver.resolve("test.example", "80", http::InternetProtocol::v4), std::system_error);
+    REQUIRE_THROWS_AS(resolver.resolve("test.example", "80", http::InternetProtocol::v4), std::system_error);
+    REQUIRE(lookup.state->count == 1);
+
+    // the failure is not cached for longer than the negative time to live
+    lookup.state->address = "127.0.0.3";
+    std::this_thread::sleep_for(std::chrono::milliseconds{150});
+    REQUIRE(resolver.resolve("test.example", "80", http::InternetProtocol::v4).size() == 1);
+    REQUIRE(lookup.state->count == 2);
+}
+
+TEST_CASE("Resolver lookup function times out", "[connection]")
+{
+    std::promise<void> release;
+    const auto released = release.get_future().share();
+
+    http::ResolverOptions options;
+    options.lookup = [released](const std::string&, const std::string& port, const http::InternetProtocol) {
+        released.wait();
+        return http::lookupAddresses("127.0.0.3", port, http::InternetProtocol::v4, AI_NUMERICHOST);
+    };
+    http::Resolver resolver{options};
+
+    const auto startTime = std::chrono::steady_clock::now();
+    REQUIRE_THROWS_AS(resolver.resolve("test.example", "80", http::InternetProtocol::v4, std::chrono::milliseconds{50}),
+                      http::ResponseError);
+    REQUIRE(std::chrono::steady_clock::now() - startTime < std::chrono::seconds{5});
+
+    // the timed out lookup is not cached
+    release.set_value();
+    REQUIRE(resolver.resolve("test.example", "80", http::InternetProtocol::v4, std::chrono::seconds{5}).size() == 1);
+}
+
+TEST_CASE("Lookup pool adds a worker for lookups stuck past their deadline", "[connection]")
+{
+    http::LookupPool pool{1};
+    std::promise<void> release;
+    const auto released = release.get_future().share();
+
+    SECTION("Without a deadline")
+    {
+        pool.post([released]() { released.wait(); });
+
+        std::promise<void> done;
+        auto result = done.get_future();
+        pool.post([&done]() { done.set_value(); });
+        REQUIRE(result.wait_for(std::chrono::milliseconds{100}) == std::future_status::timeout);
+
+        release.set_value();
+        REQUIRE(result.wait_for(std::chrono::seconds{5}) == std::future_status::ready);
+    }
+
+    SECTION("Past the deadline")
+    {
+        pool.post([released]() { released.wait(); },
+                  std::chrono::steady_clock::now() + std::chrono::milliseconds{10});
+        std::this_thread::sleep_for(std::chrono::milliseconds{50});
+
+        std::promise<void> done;
+        auto result = done.get_future();
+        pool.post([&done]() { done.set_value(); });
+        REQUIRE(result.wait_for(std::chrono::seconds{5}) == std::future_status::ready);
+
+        release.set_value();
+    }
+}
+
+TEST_CASE("Resolve numeric address with timeout", "[connection]")
+{
+    const auto addresses = http::resolve("127.0.0.1", "80", http::InternetProtocol::v4, 0);
+    REQUIRE(addresses.size() == 1);
+    REQUIRE(addresses[0].family == AF_INET);
+}
+
+TEST_CASE("Resolve asynchronously", "[connection]")
+{
+    http::Resolver resolver;
+    resolver.addOverride("test.example", "80", "127.0.0.2");
+
+    auto first = resolver.resolveAsync("test.example", "80", http::InternetProtocol::v4);
+    auto second = resolver.resolveAsync("127.0.0.3", "80", http::InternetProtocol::v4);
+    REQUIRE(first.get().size() == 1);
+    REQUIRE(second.get().size() == 1);
+}
+
+#if defined(__linux__)
+TEST_CASE("Event loop reports connection errors", "[connection]")
+{
+    for (const auto backend : {http::EventLoop::Backend::epoll, http::EventLoop::Backend::ioUring})
+    {
+        http::EventLoop eventLoop{http::InternetProtocol::v4, nullptr, backend};
+        if (backend == http::EventLoop::Backend::epoll)
+            REQUIRE(eventLoop.getBackend() == http::EventLoop::Backend::epoll);
+
+        bool failed = false;
+        eventLoop.send("http://127.0.0.1:1/", "GET", "", {}, std::chrono::seconds{5},
+                       [&failed](http::Response, std::exception_ptr error) {
+            failed = (error != nullptr);
+        });
+
+        eventLoop.run();
+        REQUIRE(failed);
+        REQUIRE(eventLoop.getPendingCount() == 0);
+    }
+}
+
+TEST_CASE("Event loop receives responses", "[connection]")
+{
+    test::LocalServer server{[](test::ServerConnection& connection) {
+        while (!connection.receiveRequest().empty())
+            connection.send(test::makeResponse("body"));
+    }};
+
+    for (const auto backend : {http::EventLoop::Backend::epoll, http::EventLoop::Backend::ioUring})
+    {
+        http::EventLoop eventLoop{http::InternetProtocol::v4, nullptr, backend};
+
+        std::vector<std::string> bodies;
+        std::size_t errorCount = 0;
+        for (int i = 0; i < 3; ++i)
+            eventLoop.send(server.getUri(), "GET", "", {}, std::chrono::seconds{5},
+                           [&bodies, &errorCount](http::Response response, std::exception_ptr error) {
+                if (error) ++errorCount;
+                bodies.emplace_back(response.body.begin(), response.body.end());
+            });
+
+        eventLoop.run();
+        REQUIRE(errorCount == 0);
+        REQUIRE(bodies == std::vector<std::string>{"body", "body", "body"});
+        REQUIRE(eventLoop.getPendingCount() == 0);
+    }
+}
+
+TEST_CASE("Event loop passes on exceptions of callbacks", "[connection]")
+{
+    test::LocalServer server{[](test::ServerConnection& connection) {
+        while (!connection.receiveRequest().empty())
+            connection.send(test::makeResponse("body"));
+    }};
+
+    for (const auto backend : {http::EventLoop::Backend::epoll, http::EventLoop::Backend::ioUring})
+    {
+        http::EventLoop eventLoop{http::InternetProtocol::v4, nullptr, backend};
+
+        std::size_t callCount = 0;
+        for (int i = 0; i < 2; ++i)
+            eventLoop.send(server.getUri(), "GET", "", {}, std::chrono::seconds{5},
+                           [&callCount](http::Response, std::exception_ptr) {
+                ++callCount;
+                throw std::runtime_error{"Callback failed"};
+            });
+
+        // every callback is called once, the loop can be run again after a callback has thrown
+        std::size_t exceptionCount = 0;
+        for (int i = 0; i < 10 && callCount < 2; ++i)
+        {
+            try
+            {
+                eventLoop.run();
+            }
+            catch (const std::runtime_error&)
+            {
+                ++exceptionCount;
+            }
+        }
+
+        REQUIRE(callCount == 2);
+        REQUIRE(exceptionCount == 2);
+        REQUIRE(eventLoop.getPendingCount() == 0);
+    }
+}
+#endif // defined(__linux__)
+
+TEST_CASE("Worker pool runs submitted jobs", "[pool]")
+{
+    http::WorkerPool workerPool{{2, 16, http::SaturationPolicy::block}};
+    REQUIRE(workerPool.getThreadCount() == 2);
+
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; ++i)
+        results.push_back(workerPool.submit([i]() { return i * 2; }));
+
+    for (int i = 0; i < 100; ++i)
+        REQUIRE(results[static_cast<std::size_t>(i)].get() == i * 2);
+}
+
+TEST_CASE("Saturated worker pool rejects jobs", "[pool]")
+{
+    http::WorkerPool workerPool{{1, 1, http::SaturationPolicy::reject}};
+
+    std::promise<void> started;
+    std::promise<void> release;
+    auto releaseFuture = release.get_future().share();
+    auto first = workerPool.submit([&started, releaseFuture]() { started.set_value(); releaseFuture.wait(); });
+    started.get_future().wait();
+
+    auto second = workerPool.submit([]() {}); // fills the queue
+    REQUIRE_THROWS_AS(workerPool.submit([]() {}), http::ResponseError);
+
+    release.set_value();
+    first.get();
+    second.get();
+}
+
+TEST_CASE("Request sendAsync reports errors through the future", "[pool]")
+{
+    http::Request request{"http://127.0.0.1:1/"};
+    auto response = request.sendAsync("GET", "", {}, std::chrono::seconds{5});
+    REQUIRE_THROWS(response.get());
+}
+
+TEST_CASE("Batch reports errors per request", "[pool]")
+{
+    http::Request first{"http://127.0.0.1:1/"};
+    http::Request second{"ftp://127.0.0.1/"};
+    http::Request third{"http://127.0.0.1:1/"};
+
+    const auto results = http::sendAll({
+        {first, "GET", {}, {}},
+        {second, "GET", {}, {}},
+        {third, "HEAD", {}, {}}
+    }, 2, std::chrono::seconds{5});
+
+    REQUIRE(results.size() == 3);
+    for (const auto& result : results)
+        REQUIRE(result.error);
+
+    REQUIRE_THROWS_AS(std::rethrow_exception(results[1].error), http::RequestError);
+}
+
+#if !defined(_WIN32) && !defined(__CYGWIN__)
+TEST_CASE("Socket options", "[connection]")
+{
+    http::SocketOptions options;
+    options.noDelay = true;
+    options.receiveBufferSize = 65536;
+    options.keepAlive = true;
+    options.typeOfService = 0x10;
+
+    http::Socket socket{http::InternetProtocol::v4, options};
+
+    int value = 0;
+    socklen_t size = sizeof(value);
+    REQUIRE(getsockopt(socket.getHandle(), IPPROTO_TCP, TCP_NODELAY, &value, &size) == 0);
+    REQUIRE(value != 0);
+
+    REQUIRE(getsockopt(socket.getHandle(), SOL_SOCKET, SO_KEEPALIVE, &value, &size) == 0);
+    REQUIRE(value != 0);
+
+    REQUIRE(getsockopt(socket.getHandle(), SOL_SOCKET, SO_RCVBUF, &value, &size) == 0);
+    REQUIRE(value >= 65536);
+
+    REQUIRE(getsockopt(socket.getHandle(), IPPROTO_IP, IP_TOS, &value, &size) == 0);
+    REQUIRE(value == 0x10);
+
+    http::Socket defaultSocket{http::InternetProtocol::v4};
+    REQUIRE(getsockopt(defaultSocket.getHandle(), IPPROTO_TCP, TCP_NODELAY, &value, &size) == 0);
+    REQUIRE(value == 0);
+}
+#endif // !defined(_WIN32) && !defined(__CYGWIN__)
+
+TEST_CASE("Fast open reports connection errors", "[connection]")
+{
+    http::SocketOptions options;
+    options.fastOpen = true;
+
+    http::Request request{"http://127.0.0.1:1/", http::InternetProtocol::v4, nullptr, options};
+    REQUIRE_THROWS_AS(request.send("GET", "", {}, std::chrono::seconds{5}), std::system_error);
+}
+
+#if !defined(_WIN32) && !defined(__CYGWIN__)
+TEST_CASE("Fast open sends the request once", "[connection]")
+{
+    std::atomic<std::size_t> requestCount{0};
+    test::LocalServer server{[&requestCount](test::ServerConnection& connection) {
+        for (auto request = connection.receiveRequest(); !request.empty(); request = connection.receiveRequest())
+        {
+            ++requestCount;
+            connection.send(test::makeResponse(test::getRequestTarget(request)));
+        }
+    }};
+
+    http::SocketOptions options;
+    options.fastOpen = true;
+
+    http::Request request{server.getUri("/a"), http::InternetProtocol::v4, nullptr, options};
+    const auto response = request.send("GET", "", {}, std::chrono::seconds{5});
+
+    REQUIRE(std::string(response.body.begin(), response.body.end()) == "/a");
+    REQUIRE(requestCount == 1);
+}
+
+TEST_CASE("Connection falls back to the next address if the first one doesn't answer", "[connection]")
+{
+    test::LocalServer server{[](test::ServerConnection& connection) {
+        while (!connection.receiveRequest().empty())
+            connection.send(test::makeResponse("body"));
+    }};
+
+    // a listener on another loopback address with the same port, whose full accept queue makes the kernel drop the SYNs
+    const auto listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(listener != -1);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1);
+    address.sin_port = htons(server.getPort());
+    REQUIRE(::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+    REQUIRE(::listen(listener, 0) == 0);
+
+    std::vector<int> queued;
+    for (bool full = false; !full && queued.size() < 16;)
+    {
+        const auto socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        queued.push_back(socket);
+        ::connect(socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        pollfd descriptor{socket, POLLOUT, 0};
+        full = ::poll(&descriptor, 1, 100) == 0;
+    }
+
+    const auto resolver = std::make_shared<http::Resolver>();
+    resolver->addOverride("test.example", std::to_string(server.getPort()), "127.0.0.2");
+    resolver->addOverride("test.example", std::to_string(server.getPort()), "127.0.0.1");
+
+    http::SocketOptions options;
+    SECTION("Regular connection") {}
+    SECTION("Fast open") { options.fastOpen = true; }
+
+    http::Request request{"http://test.example:" + std::to_string(server.getPort()) + "/",
+                          http::InternetProtocol::v4, resolver, options};
+    const auto response = request.send("GET", "", {}, std::chrono::seconds{5});
+    REQUIRE(std::string(response.body.begin(), response.body.end()) == "body");
+
+    for (const auto socket : queued)
+        ::close(socket);
+    ::close(listener);
+}
+
+TEST_CASE("Pipelined responses are returned in order", "[connection]")
+{
+    // the path of each request is sent back as the body
+    test::LocalServer server{[](test::ServerConnection& connection) {
+        for (auto request = connection.receiveRequest(); !request.empty(); request = connection.receiveRequest())
+            connection.send(test::makeResponse(test::getRequestTarget(request)));
+    }};
+
+    http::Client client{server.getUri()};
+    const auto responses = client.sendPipelined({"/a", "/b", "/c", "/d"}, "GET", {}, std::chrono::seconds{5});
+
+    REQUIRE(responses.size() == 4);
+    REQUIRE(std::string(responses[0].body.begin(), responses[0].body.end()) == "/a");
+    REQUIRE(std::string(responses[1].body.begin(), responses[1].body.end()) == "/b");
+    REQUIRE(std::string(responses[2].body.begin(), responses[2].body.end()) == "/c");
+    REQUIRE(std::string(responses[3].body.begin(), responses[3].body.end()) == "/d");
+    REQUIRE(server.getConnectionCount() == 1);
+}
+
+TEST_CASE("Pipeline depth is limited", "[connection]")
+{
+    std::atomic<bool> tooDeep{false};
+    test::LocalServer server{[&tooDeep](test::ServerConnection& connection) {
+        for (;;)
+        {
+            const auto first = connection.receiveRequest();
+            const auto second = connection.receiveRequest();
+            if (first.empty() || second.empty()) return;
+
+            // no other request is sent until one of the two has been answered
+            if (connection.hasData(100)) tooDeep = true;
+
+            connection.send(test::makeResponse(test::getRequestTarget(first)));
+            connection.send(test::makeResponse(test::getRequestTarget(second)));
+        }
+    }};
+
+    http::ClientOptions options;
+    options.pipelineDepth = 2;
+    http::Client client{server.getUri(), http::InternetProtocol::v4, options};
+    const auto responses = client.sendPipelined({"/a", "/b", "/c", "/d"}, "GET", {}, std::chrono::seconds{5});
+
+    REQUIRE(responses.size() == 4);
+    REQUIRE(std::string(responses[3].body.begin(), responses[3].body.end()) == "/d");
+    REQUIRE_FALSE(tooDeep);
+}
+
+TEST_CASE("Only idempotent requests are pipelined", "[connection]")
+{
+    http::Client client{"http://127.0.0.1:1"};
+    REQUIRE_THROWS_AS(client.sendPipelined({"/a", "/b"}, "POST"), http::RequestError);
+    REQUIRE_THROWS_AS(client.sendPipelined({"/a", "http://127.0.0.2:1/b"}), http::RequestError);
+}
+
+TEST_CASE("Unanswered pipelined requests are sent again", "[connection]")
+{
+    // the part of the second response that is sent before the first connection is closed
+    std::string cutResponse;
+    SECTION("Closed after a response") {}
+    SECTION("Closed in the middle of a header") { cutResponse = "HTTP/1.1 200 OK\r\nContent-Le"; }
+    SECTION("Closed in the middle of a body") { cutResponse = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc"; }
+
+    std::mutex mutex;
+    std::vector<std::vector<std::string>> targets; // the requests received on each connection
+    test::LocalServer server{[&mutex, &targets, &cutResponse](test::ServerConnection& connection) {
+        std::size_t connectionIndex;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            connectionIndex = targets.size();
+            targets.emplace_back();
+        }
+
+        for (auto request = connection.receiveRequest(); !request.empty(); request = connection.receiveRequest())
+        {
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                targets[connectionIndex].push_back(test::getRequestTarget(request));
+            }
+
+            // the first connection is closed after all the requests have arrived and the first one has been answered
+            if (connectionIndex == 0 && targets[connectionIndex].size() == 3)
+            {
+                connection.send(test::makeResponse("/a") + cutResponse);
+                return;
+            }
+
+            if (connectionIndex != 0)
+                connection.send(test::makeResponse(test::getRequestTarget(request)));
+        }
+    }};
+
+    http::Client client{server.getUri()};
+    const auto responses = client.sendPipelined({"/a", "/b", "/c"}, "GET", {}, std::chrono::seconds{5});
+
+    REQUIRE(responses.size() == 3);
+    REQUIRE(std::string(responses[0].body.begin(), responses[0].body.end()) == "/a");
+    REQUIRE(std::string(responses[1].body.begin(), responses[1].body.end()) == "/b");
+    REQUIRE(std::string(responses[2].body.begin(), responses[2].body.end()) == "/c");
+
+    std::lock_guard<std::mutex> lock{mutex};
+    REQUIRE(targets.size() == 2);
+    REQUIRE(targets[0] == std::vector<std::string>{"/a", "/b", "/c"});
+    REQUIRE(targets[1] == std::vector<std::string>{"/b", "/c"});
+}
+
+TEST_CASE("Request passes every response event to the sink", "[connection]")
+{
+    test::LocalServer server{[](test::ServerConnection& connection) {
+        while (!connection.receiveRequest().empty())
+            connection.send(test::makeResponse("ok", "A: 1\r\n"));
+    }};
+
+    std::vector<std::string> events;
+    http::ResponseSink sink;
+    sink.statusReceived = [&events](const http::Status& status) {
+        events.push_back("status " + std::to_string(status.code));
+    };
+    sink.headerFieldReceived = [&events](const http::HeaderField& headerField) {
+        events.push_back(headerField.first + ": " + headerField.second);
+    };
+    sink.headersReceived = [&events](const http::Status&, const http::HeaderFields&) {
+        events.push_back("headers");
+    };
+    sink.dataReceived = [&events](const std::uint8_t* data, const std::size_t size) {
+        events.push_back(std::string(reinterpret_cast<const char*>(data), size));
+    };
+
+    http::Request request{server.getUri(), http::InternetProtocol::v4};
+    const auto response = request.send("GET", "", {}, sink, std::chrono::seconds{5});
+
+    REQUIRE(response.status.code == 200);
+    REQUIRE(response.body.empty());
+    REQUIRE(events == std::vector<std::string>{"status 200", "content-length: 2", "a: 1", "headers", "ok"});
+
+    // the body is collected into the response if the sink doesn't take it
+    events.clear();
+    sink.dataReceived = nullptr;
+    const auto collected = request.send("GET", "", {}, sink, std::chrono::seconds{5});
+
+    REQUIRE(std::string(collected.body.begin(), collected.body.end()) == "ok");
+    REQUIRE(events == std::vector<std::string>{"status 200", "content-length: 2", "a: 1", "headers"});
+}
+
+TEST_CASE("Chunked request body is framed on the wire", "[connection]")
+{
+    std::promise<std::string> received;
+    test::LocalServer server{[&received](test::ServerConnection& connection) {
+        received.set_value(connection.receiveRequest());
+        connection.send(test::makeResponse(""));
+    }};
+
+    // the sizes include the whole buffer and ones with hexadecimal letters,
+    // the small send buffer makes the socket accept only parts of the chunks
+    const std::vector<std::size_t> sizes{1, 15, 16384, 255, 4096, 10000, 16384, 16384, 3};
+    std::string produced;
+    std::size_t chunkIndex = 0;
+    const http::ChunkedBody body{[&](std::uint8_t* buffer, const std::size_t size) {
+        if (chunkIndex == sizes.size() * 16) return std::size_t{0};
+        const auto chunkSize = sizes[chunkIndex++ % sizes.size()];
+        REQUIRE(chunkSize <= size);
+        for (std::size_t i = 0; i < chunkSize; ++i)
+            buffer[i] = static_cast<std::uint8_t>('a' + (produced.size() + i) % 26);
+        produced.append(reinterpret_cast<const char*>(buffer), chunkSize);
+        return chunkSize;
+    }};
+
+    http::SocketOptions options;
+    options.sendBufferSize = 4096;
+    http::Request request{server.getUri(), http::InternetProtocol::v4, nullptr, options};
+    REQUIRE(request.send("POST", body, {}, std::chrono::seconds{5}).status.code == 200);
+
+    const auto message = received.get_future().get();
+    const auto headEnd = message.find("\r\n\r\n") + 4;
+    REQUIRE(message.substr(0, headEnd).find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+
+    // every produced chunk is sent as one chunk, followed by the last chunk and an empty trailer section
+    std::string decoded;
+    std::vector<std::size_t> chunkSizes;
+    for (std::size_t i = headEnd;;)
+    {
+        const auto sizeLineEnd = message.find("\r\n", i);
+        REQUIRE(sizeLineEnd != std::string::npos);
+        const auto chunkSize = std::stoul(message.substr(i, sizeLineEnd - i), nullptr, 16);
+        REQUIRE(message.substr(i, sizeLineEnd - i).find_first_not_of("0123456789ABCDEF") == std::string::npos);
+        i = sizeLineEnd + 2;
+
+        if (chunkSize == 0)
+        {
+            REQUIRE(message.substr(i) == "\r\n");
+            break;
+        }
+
+        chunkSizes.push_back(chunkSize);
+        decoded += message.substr(i, chunkSize);
+        i += chunkSize;
+        REQUIRE(message.substr(i, 2) == "\r\n");
+        i += 2;
+    }
+
+    REQUIRE(chunkSizes.size() == sizes.size() * 16);
+    for (std::size_t i = 0; i < chunkSizes.size(); ++i)
+        REQUIRE(chunkSizes[i] == sizes[i % sizes.size()]);
+    REQUIRE(decoded == produced);
+}
+
+namespace
+{
+    // a temporary file that is removed when it goes out of scope
+    class TemporaryFile final
+    {
+    public:
+        TemporaryFile():
+            descriptor{::mkstemp(&path[0])}
+        {
+            if (descriptor == -1)
+                throw std::system_error{errno, std::system_category(), "Failed to create file"};
+        }
+
+        ~TemporaryFile()
+        {
+            ::close(descriptor);
+            ::unlink(path.c_str());
+        }
+
+        TemporaryFile(const TemporaryFile&) = delete;
+        TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+        int getDescriptor() const noexcept { return descriptor; }
+
+        void write(const std::string& data)
+        {
+            for (std::size_t written = 0; written < data.size();)
+            {
+                const auto size = ::pwrite(descriptor, data.data() + written, data.size() - written,
+                                           static_cast<off_t>(written));
+                if (size == -1)
+                    throw std::system_error{errno, std::system_category(), "Failed to write file"};
+                written += static_cast<std::size_t>(size);
+            }
+        }
+
+        std::string read() const
+        {
+            std::string result;
+            char buffer[4096];
+            for (off_t offset = 0;;)
+            {
+                const auto size = ::pread(descriptor, buffer, sizeof(buffer), offset);
+                if (size <= 0) return result;
+                result.append(buffer, static_cast<std::size_t>(size));
+                offset += size;
+            }
+        }
+
+    private:
+        std::string path = "/tmp/HTTPRequestXXXXXX";
+        int descriptor;
+    };
+
+    std::string makeBody(const std::size_t size)
+    {
+        std::string result(size, '\0');
+        for (std::size_t i = 0; i < size; ++i)
+            result[i] = static_cast<char>('a' + i % 26);
+        return result;
+    }
+
+    std::string makeChunkedResponse(const std::string& body)
+    {
+        std::string result = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for (std::size_t i = 0; i < body.size(); i += 1000)
+        {
+            const auto chunk = body.substr(i, 1000);
+            char sizeLine[32];
+            std::snprintf(sizeLine, sizeof(sizeLine), "%zX\r\n", chunk.size());
+            result += sizeLine + chunk + "\r\n";
+        }
+        return result + "0\r\n\r\n";
+    }
+}
+
+TEST_CASE("Download writes the body to the file", "[connection]")
+{
+    const auto body = makeBody(256 * 1024);
+    test::LocalServer server{[&body](test::ServerConnection& connection) {
+        for (auto request = connection.receiveRequest(); !request.empty(); request = connection.receiveRequest())
+        {
+            const auto target = test::getRequestTarget(request);
+            if (target == "/chunked")
+                connection.send(makeChunkedResponse(body));
+            else if (target == "/close")
+            {
+                connection.send("HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n" + body);
+                return;
+            }
+            else
+                connection.send(test::makeResponse(body));
+        }
+    }};
+
+    TemporaryFile file;
+
+    SECTION("Spliced")
+    {
+        http::Request request{server.getUri(), http::InternetProtocol::v4};
+        const auto response = request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5});
+        REQUIRE(response.status.code == 200);
+        REQUIRE(response.body.empty());
+        REQUIRE(file.read() == body);
+    }
+
+    SECTION("Written from a buffer to a file that doesn't support splice")
+    {
+        REQUIRE(::fcntl(file.getDescriptor(), F_SETFL, O_APPEND) == 0);
+        http::Request request{server.getUri(), http::InternetProtocol::v4};
+        request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5});
+        REQUIRE(file.read() == body);
+    }
+
+    SECTION("Chunked")
+    {
+        http::Request request{server.getUri("/chunked"), http::InternetProtocol::v4};
+        request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5});
+        REQUIRE(file.read() == body);
+    }
+
+    SECTION("Ended by closing the connection")
+    {
+        http::Request request{server.getUri("/close"), http::InternetProtocol::v4};
+        request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5});
+        REQUIRE(file.read() == body);
+    }
+}
+
+TEST_CASE("Download reports a body cut short", "[connection]")
+{
+    const auto body = makeBody(256 * 1024);
+    test::LocalServer server{[&body](test::ServerConnection& connection) {
+        const auto request = connection.receiveRequest();
+        if (test::getRequestTarget(request) == "/chunked")
+        {
+            const auto response = makeChunkedResponse(body);
+            connection.send(response.substr(0, response.size() / 2));
+        }
+        else
+            connection.send(test::makeResponse(body).substr(0, body.size() / 2));
+    }};
+
+    TemporaryFile file;
+
+    SECTION("Spliced")
+    {
+        http::Request request{server.getUri(), http::InternetProtocol::v4};
+        REQUIRE_THROWS_AS(request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5}), http::ResponseError);
+    }
+
+    SECTION("Written from a buffer to a file that doesn't support splice")
+    {
+        REQUIRE(::fcntl(file.getDescriptor(), F_SETFL, O_APPEND) == 0);
+        http::Request request{server.getUri(), http::InternetProtocol::v4};
+        REQUIRE_THROWS_AS(request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5}), http::ResponseError);
+    }
+
+    SECTION("Chunked")
+    {
+        http::Request request{server.getUri("/chunked"), http::InternetProtocol::v4};
+        REQUIRE_THROWS_AS(request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5}), http::ResponseError);
+    }
+}
+
+TEST_CASE("Download returns error bodies in the response", "[connection]")
+{
+    const auto body = makeBody(64 * 1024);
+    test::LocalServer server{[&body](test::ServerConnection& connection) {
+        while (!connection.receiveRequest().empty())
+            connection.send("HTTP/1.1 404 Not Found\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+    }};
+
+    TemporaryFile file;
+    http::Request request{server.getUri(), http::InternetProtocol::v4};
+
+    const auto response = request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5});
+    REQUIRE(response.status.code == 404);
+    REQUIRE(std::string(response.body.begin(), response.body.end()) == body);
+    REQUIRE(file.read().empty());
+
+    // unless the caller wants them in the file
+    const auto written = request.download(file.getDescriptor(), "GET", {}, std::chrono::seconds{5}, true);
+    REQUIRE(written.status.code == 404);
+    REQUIRE(written.body.empty());
+    REQUIRE(file.read() == body);
+}
+
+TEST_CASE("File is sent in parts while the send buffer is full", "[connection]")
+{
+    const auto data = makeBody(4 * 1024 * 1024);
+    TemporaryFile file;
+    file.write(data);
+
+    std::promise<void> release;
+    const auto released = release.get_future().share();
+    std::promise<std::string> received;
+    test::LocalServer server{[released, &received](test::ServerConnection& connection) {
+        released.wait();
+        received.set_value(connection.receiveRequest());
+    }};
+
+    http::SocketOptions options;
+    options.sendBufferSize = 4096;
+    http::Socket socket{http::InternetProtocol::v4, options};
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(server.getPort());
+    socket.connect(reinterpret_cast<const sockaddr*>(&address), sizeof(address), 5000);
+
+    const std::string head = "POST / HTTP/1.1\r\nContent-Length: " + std::to_string(data.size()) + "\r\n\r\n";
+    for (std::size_t sent = 0; sent < head.size();)
+        sent += socket.send(head.data() + sent, head.size() - sent, 5000);
+
+    // the server doesn't read yet, so only parts of the file fit until the send buffer is full
+    std::size_t offset = 0;
+    bool partial = false;
+    while (offset < data.size())
+    {
+        const auto result = socket.trySendFile(file.getDescriptor(), offset, data.size() - offset);
+        if (!result) break;
+        REQUIRE(*result > 0);
+        if (*result < data.size() - offset) partial = true;
+        offset += *result;
+    }
+
+    REQUIRE(partial);
+    REQUIRE(offset < data.size());
+
+    // the rest is sent from where the partial writes have stopped
+    release.set_value();
+    while (offset < data.size())
+        offset += socket.sendFile(file.getDescriptor(), offset, data.size() - offset, 5000);
+
+    REQUIRE(received.get_future().get() == head + data);
+}
+
+TEST_CASE("Request sends a range of a file", "[connection]")
+{
+    // the body of the request is sent back
+    test::LocalServer server{[](test::ServerConnection& connection) {
+        for (auto request = connection.receiveRequest(); !request.empty(); request = connection.receiveRequest())
+            connection.send(test::makeResponse(request.substr(request.find("\r\n\r\n") + 4)));
+    }};
+
+    const auto data = makeBody(256 * 1024);
+    TemporaryFile file;
+    file.write(data);
+
+    http::Request request{server.getUri(), http::InternetProtocol::v4};
+
+    SECTION("From the offset to the end")
+    {
+        const auto response = request.send("PUT", http::FileBody{file.getDescriptor(), 1000}, {}, std::chrono::seconds{5});
+        REQUIRE(std::string(response.body.begin(), response.body.end()) == data.substr(1000));
+    }
+
+    SECTION("With a length")
+    {
+        const auto response = request.send("PUT", http::FileBody{file.getDescriptor(), 1000, 100000}, {}, std::chrono::seconds{5});
+        REQUIRE(std::string(response.body.begin(), response.body.end()) == data.substr(1000, 100000));
+    }
+}
+
+TEST_CASE("Sending a file to a reset connection raises no SIGPIPE", "[connection]")
+{
+    const auto data = makeBody(64 * 1024);
+    TemporaryFile file;
+    file.write(data);
+
+    const auto listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(listener != -1);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressSize = sizeof(address);
+    REQUIRE(::bind(listener, reinterpret_cast<const sockaddr*>(&address), addressSize) == 0);
+    REQUIRE(::listen(listener, 1) == 0);
+    REQUIRE(::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressSize) == 0);
+
+    http::Socket socket{http::InternetProtocol::v4};
+    socket.connect(reinterpret_cast<const sockaddr*>(&address), addressSize, 5000);
+
+    // closing with a zero linger time resets the connection
+    const auto connection = ::accept(listener, nullptr, nullptr);
+    REQUIRE(connection != -1);
+    const linger noLinger{1, 0};
+    REQUIRE(::setsockopt(connection, SOL_SOCKET, SO_LINGER, &noLinger, sizeof(noLinger)) == 0);
+    ::close(connection);
+    ::close(listener);
+
+    // the default action of SIGPIPE would end the test run
+    struct sigaction defaultAction{};
+    defaultAction.sa_handler = SIG_DFL;
+    sigemptyset(&defaultAction.sa_mask);
+    struct sigaction previousAction{};
+    REQUIRE(::sigaction(SIGPIPE, &defaultAction, &previousAction) == 0);
+
+    // the first send after the reset fails with ECONNRESET and the next ones with EPIPE
+    int errorCount = 0;
+    for (int i = 0; i < 100 && errorCount < 2; ++i)
+    {
+        try
+        {
+            socket.trySendFile(file.getDescriptor(), 0, data.size());
+        }
+        catch (const std::system_error&)
+        {
+            ++errorCount;
+        }
+    }
+
+    sigset_t pendingSignals;
+    sigemptyset(&pendingSignals);
+    sigpending(&pendingSignals);
+    ::sigaction(SIGPIPE, &previousAction, nullptr);
+
+    REQUIRE(errorCount == 2);
+    REQUIRE(sigismember(&pendingSignals, SIGPIPE) == 0);
+}
+
+TEST_CASE("Body is received straight into the response body", "[connection]")
+{
+    const auto data = makeBody(1024 * 1024);
+    std::promise<void> sent;
+    test::LocalServer server{[&data, &sent](test::ServerConnection& connection) {
+        // the reads fill the buffer while the first part is waiting in the socket,
+        // and the data after the body must be left in the socket
+        connection.send(data.substr(0, 65536));
+        sent.set_value();
+        connection.send(data.substr(65536) + "next");
+        connection.hasData(5000);
+    }};
+
+    http::Socket socket{http::InternetProtocol::v4};
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(server.getPort());
+    socket.connect(reinterpret_cast<const sockaddr*>(&address), sizeof(address), 5000);
+    sent.get_future().wait();
+
+    // the body already has data from the parser and is reserved for the rest
+    std::vector<std::uint8_t> body{'x'};
+    body.reserve(1 + data.size());
+    const auto capacity = body.capacity();
+
+    http::ReceiveBuffer buffer;
+    const auto stopTime = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    REQUIRE(http::receiveBody(socket, body, data.size(), buffer, std::chrono::seconds{5}, stopTime) == data.size());
+
+    REQUIRE(std::string(body.begin(), body.end()) == "x" + data);
+    REQUIRE(body.capacity() == capacity);
+    // the reads were filled, so the read size has grown
+    REQUIRE(buffer.size() > http::minReceiveSize);
+    REQUIRE(buffer.size() <= http::maxReceiveSize);
+
+    char next[8];
+    REQUIRE(socket.recv(next, sizeof(next), 5000) == 4);
+    REQUIRE(std::string(next, 4) == "next");
+}
+
+TEST_CASE("Body receiving stops when the peer disconnects", "[connection]")
+{
+    const auto data = makeBody(64 * 1024);
+    test::LocalServer server{[&data](test::ServerConnection& connection) {
+        connection.send(data.substr(0, data.size() / 2));
+    }};
+
+    http::Socket socket{http::InternetProtocol::v4};
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(server.getPort());
+    socket.connect(reinterpret_cast<const sockaddr*>(&address), sizeof(address), 5000);
+
+    std::vector<std::uint8_t> body;
+    http::ReceiveBuffer buffer;
+    const auto stopTime = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    REQUIRE(http::receiveBody(socket, body, data.size(), buffer, std::chrono::seconds{5}, stopTime) == data.size() / 2);
+    REQUIRE(std::string(body.begin(), body.end()) == data.substr(0, data.size() / 2));
+}
+
+TEST_CASE("Response body with a known length is received in full", "[connection]")
+{
+    const auto body = makeBody(1024 * 1024 + 1);
+    test::LocalServer server{[&body](test::ServerConnection& connection) {
+        while (!connection.receiveRequest().empty())
+            connection.send(test::makeResponse(body));
+    }};
+
+    http::Request request{server.getUri(), http::InternetProtocol::v4};
+    const auto response = request.send("GET", "", {}, std::chrono::seconds{5});
+    REQUIRE(std::string(response.body.begin(), response.body.end()) == body);
+
+    // the connection is still usable after the body
+    const auto next = request.send("GET", "", {}, std::chrono::seconds{5});
+    REQUIRE(next.body.size() == body.size());
+    REQUIRE(server.getConnectionCount() == 1);
+}
+
+#if defined(__cpp_lib_memory_resource)
+namespace
+{
+    // records the size of every allocation and takes the memory from the default resource
+    class RecordingResource final: public std::pmr::memory_resource
+    {
+    public:
+        std::vector<std::size_t> sizes;
+
+    private:
+        void* do_allocate(const std::size_t bytes, const std::size_t alignment) override
+        {
+            sizes.push_back(bytes);
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, const std::size_t bytes, const std::size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+}
+
+TEST_CASE("Compact response takes only the response data from the memory resource", "[connection]")
+{
+    const std::string body(1024 * 1024, 'a');
+    test::LocalServer server{[&body](test::ServerConnection& connection) {
+        while (!connection.receiveRequest().empty())
+            connection.send(test::makeResponse(body));
+    }};
+
+    RecordingResource resource;
+    http::Request request{server.getUri(), http::InternetProtocol::v4};
+    const auto response = request.sendCompact("GET", "", {}, std::chrono::seconds{5}, &resource);
+    REQUIRE(response.body.size() == body.size());
+
+    // the body is allocated once for its whole length, the receive buffer is not allocated from the resource
+    REQUIRE(std::count(resource.sizes.begin(), resource.sizes.end(), body.size()) == 1);
+    for (const auto size : resource.sizes)
+        if (size != body.size()) REQUIRE(size < 4096);
+}
+#endif // defined(__cpp_lib_memory_resource)
+#endif // !defined(_WIN32) && !defined(__CYGWIN__)
@@ -0,0 +1,150 @@
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "catch2/catch.hpp"
+#include "HTTPRequest.hpp"
+#include "server.hpp"
+
+#if !defined(_WIN32) && !defined(__CYGWIN__)
+#  include <sys/resource.h>
+#endif // !defined(_WIN32) && !defined(__CYGWIN__)
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
+namespace
+{
+    struct DetachedCoroutine final
+    {
+        struct promise_type final
+        {
+            DetachedCoroutine get_return_object() const noexcept { return {}; }
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept {}
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+
+    // sends a GET request from a coroutine that is resumed on the thread that has finished waiting
+    DetachedCoroutine sendRequest(const std::string uri,
+                                  const std::shared_ptr<http::Resolver> resolver,
+                                  const std::chrono::milliseconds timeout,
+                                  std::promise<http::Response>& result)
+    {
+        http::Request request{uri, http::InternetProtocol::v4, resolver};
+        try
+        {
+            result.set_value(co_await request.sendAsync([](std::function<void()> function) { function(); },
+                                                        "GET", "", {}, timeout));
+        }
+        catch (...)
+        {
+            result.set_exception(std::current_exception());
+        }
+    }
+}
+
+TEST_CASE("Coroutine reports connection errors", "[coroutine]")
+{
+    std::promise<http::Response> response;
+    auto result = response.get_future();
+    sendRequest("http://127.0.0.1:1/", nullptr, std::chrono::seconds{5}, response);
+    REQUIRE_THROWS_AS(result.get(), std::system_error);
+}
+
+TEST_CASE("Coroutine receives a response", "[coroutine]")
+{
+    test::LocalServer server{[](test::ServerConnection& connection) {
+        while (!connection.receiveRequest().empty())
+            connection.send(test::makeResponse("body"));
+    }};
+
+    SECTION("Numeric address")
+    {
+        std::promise<http::Response> response;
+        auto result = response.get_future();
+        sendRequest(server.getUri(), nullptr, std::chrono::seconds{5}, response);
+
+        const auto body = result.get().body;
+        REQUIRE(std::string(body.begin(), body.end()) == "body");
+    }
+
+    SECTION("Host name")
+    {
+        // the host name is resolved on the lookup pool while the coroutine is suspended
+        const auto resolver = std::make_shared<http::Resolver>();
+        resolver->addOverride("test.example", std::to_string(server.getPort()), "127.0.0.1");
+
+        std::promise<http::Response> response;
+        auto result = response.get_future();
+        sendRequest("http://test.example:" + std::to_string(server.getPort()) + "/", resolver, std::chrono::seconds{5}, response);
+
+        const auto body = result.get().body;
+        REQUIRE(std::string(body.begin(), body.end()) == "body");
+    }
+}
+
+TEST_CASE("Coroutine lookup times out", "[coroutine]")
+{
+    std::promise<void> release;
+    const auto released = release.get_future().share();
+
+    http::ResolverOptions options;
+    options.lookup = [released](const std::string&, const std::string& port, const http::InternetProtocol) {
+        released.wait();
+        return http::lookupAddresses("127.0.0.1", port, http::InternetProtocol::v4, AI_NUMERICHOST);
+    };
+    const auto resolver = std::make_shared<http::Resolver>(options);
+
+    // the deadline has passed before the lookup starts, so the coroutine is resumed by the reactor right away
+    for (int i = 0; i < 10; ++i)
+    {
+        std::promise<http::Response> response;
+        auto result = response.get_future();
+        sendRequest("http://test.example:1/", resolver, std::chrono::milliseconds{0}, response);
+        REQUIRE_THROWS_AS(result.get(), http::ResponseError);
+    }
+
+    release.set_value();
+}
+TEST_CASE("Reactor ends the waits when poll fails", "[coroutine]")
+{
+    auto& reactor = http::getReactor();
+
+    constexpr std::size_t waitCount = 32;
+    std::vector<std::promise<bool>> results(waitCount);
+    std::vector<std::future<bool>> futures;
+    for (auto& result : results)
+        futures.push_back(result.get_future());
+
+    // the deadlines are far away, so only the failure can end the waits
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::hours{1};
+    for (std::size_t i = 0; i + 1 < waitCount; ++i)
+        reactor.wait(-1, 0, deadline, [&result = results[i]](const bool ready) { result.set_value(ready); });
+
+    // poll fails with EINVAL for more descriptors than RLIMIT_NOFILE allows,
+    // the last wait wakes the reactor up to poll all of them again
+    rlimit previousLimit{};
+    REQUIRE(::getrlimit(RLIMIT_NOFILE, &previousLimit) == 0);
+    rlimit limit = previousLimit;
+    limit.rlim_cur = 16;
+    REQUIRE(::setrlimit(RLIMIT_NOFILE, &limit) == 0);
+    reactor.wait(-1, 0, deadline, [&result = results.back()](const bool ready) { result.set_value(ready); });
+
+    std::size_t endedCount = 0;
+    bool anyReady = false;
+    for (auto& future : futures)
+        if (future.wait_for(std::chrono::seconds{5}) == std::future_status::ready)
+        {
+            ++endedCount;
+            anyReady = anyReady || future.get();
+        }
+
+    ::setrlimit(RLIMIT_NOFILE, &previousLimit);
+
+    REQUIRE(endedCount == waitCount);
+    REQUIRE_FALSE(anyReady);
+}
+#endif // defined(__cpp_impl_coroutine) && __has_include(<coroutine>) && !defined(_WIN32) && !defined(__CYGWIN__)
@@ -1,4 +1,5 @@
 #include <cstddef>
+#include <cstdio>
 #include "catch2/catch.hpp"
 #include "HTTPRequest.hpp"
 
@@ -54,6 +55,13 @@ TEST_CASE("Encode header with a new-line in value", "[serialization]")
     }), http::RequestError);
 }
 
+TEST_CASE("Encode header with a new-line in a long value", "[serialization]")
+{
+    REQUIRE_THROWS_AS(http::encodeHeaderFields({
+        {"a", std::string(40, 'b') + '\n' + std::string(40, 'b')}
+    }), http::RequestError);
+}
+
 TEST_CASE("Encode Base64", "[serialization]")
 {
     const std::string str = "test:test";
@@ -93,3 +101,112 @@ TEST_CASE("Encode HTML with data", "[serialization]")
     for (std::size_t i = 0; i < check.size(); ++i)
         REQUIRE(static_cast<uint8_t>(check[i]) == result[i]);
 }
+
+TEST_CASE("Encode request buffers", "[serialization]")
+{
+    http::Uri uri;
+    uri.scheme = "http";
+    uri.path = "/";
+    uri.host = "test.com";
+    const std::vector<std::uint8_t> body = {'1', '2'};
+
+    const auto request = http::detail::encodeRequest(uri, "POST", body, {});
+    const std::string head = "POST / HTTP/1.1\r\nHost: test.com\r\nContent-Length: 2\r\n\r\n";
+
+    REQUIRE(request.head == head);
+    REQUIRE(request.body == body.data());
+    REQUIRE(request.size() == head.size() + body.size());
+
+    std::array<http::detail::ConstBuffer, 2> buffers;
+
+    REQUIRE(request.getBuffers(0, buffers) == 2);
+    REQUIRE(buffers[0].data == request.head.data());
+    REQUIRE(buffers[0].size == head.size());
+    REQUIRE(buffers[1].data == body.data());
+    REQUIRE(buffers[1].size == body.size());
+
+    REQUIRE(request.getBuffers(head.size() - 1, buffers) == 2);
+    REQUIRE(buffers[0].data == request.head.data() + head.size() - 1);
+    REQUIRE(buffers[0].size == 1);
+    REQUIRE(buffers[1].data == body.data());
+
+    REQUIRE(request.getBuffers(head.size() + 1, buffers) == 1);
+    REQUIRE(buffers[0].data == body.data() + 1);
+    REQUIRE(buffers[0].size == 1);
+
+    REQUIRE(request.getBuffers(request.size(), buffers) == 0);
+}
+
+TEST_CASE("Encode request with a string body", "[serialization]")
+{
+    http::Uri uri;
+    uri.scheme = "http";
+    uri.path = "/";
+    uri.host = "test.com";
+    const std::string body = "12";
+
+    // the body is sent from the string without a copy
+    const auto request = http::detail::encodeRequest(uri, "POST", body, {});
+    const std::string head = "POST / HTTP/1.1\r\nHost: test.com\r\nContent-Length: 2\r\n\r\n";
+
+    REQUIRE(request.head == head);
+    REQUIRE(static_cast<const void*>(request.body) == static_cast<const void*>(body.data()));
+    REQUIRE(request.bodySize == body.size());
+    REQUIRE(request.size() == head.size() + body.size());
+}
+
+TEST_CASE("Encode request with a chunked body", "[serialization]")
+{
+    http::Uri uri;
+    uri.scheme = "http";
+    uri.path = "/";
+    uri.host = "test.com";
+
+    const http::ChunkedBody body{[](std::uint8_t*, std::size_t) { return std::size_t{0}; }};
+
+    const auto request = http::detail::encodeRequest(uri, "POST", body, {});
+    const std::string head = "POST / HTTP/1.1\r\nHost: test.com\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+    REQUIRE(request.head == head);
+    REQUIRE(request.size() == head.size());
+    REQUIRE(request.chunkedBody == &body);
+    REQUIRE_FALSE(request.isReplayable());
+
+    REQUIRE_THROWS_AS(http::detail::encodeRequest(uri, "POST", http::ChunkedBody{}, {}), http::RequestError);
+}
+
+#if !defined(_WIN32)
+TEST_CASE("Encode request with a file body", "[serialization]")
+{
+    const std::unique_ptr<std::FILE, decltype(&std::fclose)> file{std::tmpfile(), &std::fclose};
+    REQUIRE(file);
+    REQUIRE(std::fputs("0123456789", file.get()) >= 0);
+    REQUIRE(std::fflush(file.get()) == 0);
+
+    http::Uri uri;
+    uri.scheme = "http";
+    uri.path = "/";
+    uri.host = "test.com";
+
+    const http::FileBody body{fileno(file.get()), 2, 5};
+    REQUIRE(body.getOffset() == 2);
+    REQUIRE(body.getSize() == 5);
+
+    const auto request = http::detail::encodeRequest(uri, "PUT", body, {});
+    const std::string head = "PUT / HTTP/1.1\r\nHost: test.com\r\nContent-Length: 5\r\n\r\n";
+
+    REQUIRE(request.head == head);
+    REQUIRE(request.size() == head.size() + 5);
+    REQUIRE(request.file == fileno(file.get()));
+    REQUIRE(request.fileOffset == 2);
+
+    // only the head is sent from memory
+    std::array<http::detail::ConstBuffer, 2> buffers;
+    REQUIRE(request.getBuffers(0, buffers) == 1);
+    REQUIRE(request.getBuffers(head.size(), buffers) == 0);
+
+    REQUIRE(http::FileBody{fileno(file.get()), 3}.getSize() == 7);
+    REQUIRE_THROWS_AS(http::FileBody(fileno(file.get()), 11), http::RequestError);
+    REQUIRE_THROWS_AS(http::FileBody(fileno(file.get()), 5, 6), http::RequestError);
+}
+#endif // !defined(_WIN32)
@@ -0,0 +1,238 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#if !defined(_WIN32) && !defined(__CYGWIN__)
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace test
+{
+    // The server side of a connection accepted by a LocalServer, which is used with blocking calls
+    class ServerConnection final
+    {
+    public:
+        explicit ServerConnection(const int s) noexcept:
+            socket{s}
+        {
+        }
+
+        // returns the next request with its body, or an empty string if the client has disconnected before it ended
+        std::string receiveRequest()
+        {
+            std::size_t headEnd;
+            while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+                if (!fill()) return {};
+
+            headEnd += 4;
+            std::size_t requestEnd = headEnd;
+
+            const auto head = buffer.substr(0, headEnd);
+            const auto contentLength = head.find("Content-Length: ");
+            if (contentLength != std::string::npos)
+            {
+                requestEnd += std::stoul(head.substr(contentLength + 16));
+                while (buffer.size() < requestEnd)
+                    if (!fill()) return {};
+            }
+            else if (head.find("Transfer-Encoding: chunked") != std::string::npos)
+            {
+                // the last chunk has no data and is followed by an empty trailer section
+                while ((requestEnd = buffer.find("\r\n0\r\n\r\n", headEnd - 2)) == std::string::npos)
+                    if (!fill()) return {};
+                requestEnd += 7;
+            }
+
+            auto request = buffer.substr(0, requestEnd);
+            buffer.erase(0, requestEnd);
+            return request;
+        }
+
+        void send(const std::string& data)
+        {
+            for (std::size_t sent = 0; sent < data.size();)
+            {
+                const auto result = ::send(socket, data.data() + sent, data.size() - sent, noSignal);
+                if (result == -1)
+                {
+                    if (errno == EINTR) continue;
+                    throw std::system_error{errno, std::system_category(), "Failed to send data"};
+                }
+                sent += static_cast<std::size_t>(result);
+            }
+        }
+
+        // checks whether the client sends anything within the timeout
+        bool hasData(const int timeout)
+        {
+            if (!buffer.empty()) return true;
+
+            pollfd descriptor{socket, POLLIN, 0};
+            return ::poll(&descriptor, 1, timeout) > 0;
+        }
+
+        // closes the connection without reading the rest of the data
+        void close() noexcept
+        {
+            ::shutdown(socket, SHUT_RDWR);
+        }
+
+    private:
+        bool fill()
+        {
+            char data[4096];
+            auto result = ::recv(socket, data, sizeof(data), 0);
+            while (result == -1 && errno == EINTR)
+                result = ::recv(socket, data, sizeof(data), 0);
+
+            if (result <= 0) return false;
+            buffer.append(data, static_cast<std::size_t>(result));
+            return true;
+        }
+
+#if defined(MSG_NOSIGNAL)
+        static constexpr int noSignal = MSG_NOSIGNAL;
+#else
+        static constexpr int noSignal = 0;
+#endif // defined(MSG_NOSIGNAL)
+
+        int socket;
+        std::string buffer;
+    };
+
+    // An HTTP server on the loopback interface for the tests, which runs the handler on its own thread
+    // for every connection, the connections are shut down when the server is destroyed
+    class LocalServer final
+    {
+    public:
+        using Handler = std::function<void(ServerConnection& connection)>;
+
+        explicit LocalServer(Handler connectionHandler):
+            handler{std::move(connectionHandler)},
+            listener{::socket(AF_INET, SOCK_STREAM, 0)}
+        {
+            if (listener == -1)
+                throw std::system_error{errno, std::system_category(), "Failed to create socket"};
+
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t addressSize = sizeof(address);
+
+            if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), addressSize) == -1 ||
+                ::listen(listener, 16) == -1 ||
+                ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressSize) == -1)
+            {
+                const auto error = errno;
+                ::close(listener);
+                throw std::system_error{error, std::system_category(), "Failed to listen"};
+            }
+
+            port = ntohs(address.sin_port);
+            acceptThread = std::thread{&LocalServer::run, this};
+        }
+
+        ~LocalServer()
+        {
+            stopping = true;
+            acceptThread.join();
+            ::close(listener);
+
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                for (const auto connection : connections)
+                    ::shutdown(connection, SHUT_RDWR);
+            }
+
+            for (auto& thread : threads)
+                thread.join();
+
+            for (const auto connection : connections)
+                ::close(connection);
+        }
+
+        LocalServer(const LocalServer&) = delete;
+        LocalServer& operator=(const LocalServer&) = delete;
+
+        std::uint16_t getPort() const noexcept
+        {
+            return port;
+        }
+
+        std::string getUri(const std::string& path = "/") const
+        {
+            return "http://127.0.0.1:" + std::to_string(port) + path;
+        }
+
+        std::size_t getConnectionCount() const noexcept
+        {
+            return connectionCount;
+        }
+
+    private:
+        void run()
+        {
+            while (!stopping)
+            {
+                pollfd descriptor{listener, POLLIN, 0};
+                if (::poll(&descriptor, 1, 10) <= 0) continue;
+
+                const auto connection = ::accept(listener, nullptr, nullptr);
+                if (connection == -1) continue;
+
+                std::lock_guard<std::mutex> lock{mutex};
+                connections.push_back(connection);
+                ++connectionCount;
+                threads.emplace_back([this, connection]() {
+                    ServerConnection serverConnection{connection};
+                    try
+                    {
+                        handler(serverConnection);
+                    }
+                    catch (const std::exception&)
+                    {
+                    }
+                    serverConnection.close();
+                });
+            }
+        }
+
+        Handler handler;
+        int listener;
+        std::uint16_t port = 0;
+        std::atomic<bool> stopping{false};
+        std::atomic<std::size_t> connectionCount{0};
+        std::mutex mutex;
+        std::vector<int> connections;
+        std::vector<std::thread> threads;
+        std::thread acceptThread;
+    };
+
+    // the request target from the request line
+    inline std::string getRequestTarget(const std::string& request)
+    {
+        const auto targetBegin = request.find(' ') + 1;
+        return request.substr(targetBegin, request.find(' ', targetBegin) - targetBegin);
+    }
+
+    // a complete response with the body
+    inline std::string makeResponse(const std::string& body, const std::string& headerFields = {})
+    {
+        return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" + headerFields + "\r\n" + body;
+    }
+}
+#endif // !defined(_WIN32) && !defined(__CYGWIN__)
+
+#endif // SERVER_HPP